@@ -0,0 +1,283 @@
+#include "deferred_printf.h"
+#include "deferred_printf_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4996) // Suppress warning: 'fopen' is deprecated
+#define fileno _fileno
+#endif
+
+/**
+ * @brief Benchmarks of logging and replaying; run a release build, e.g. `bench_deferred_printf [repetitions]`.
+ *
+ * Each row reports the mean, the median, and the 90th and 99th percentiles in nanoseconds per operation. The percentiles are those of
+ * batches of operations, since the clock is too coarse to time a single log call.
+ */
+namespace
+{
+    using clock_type = std::chrono::steady_clock;
+
+    size_t g_zuRepetitions = 100; // the number of timed batches per row
+
+    /**
+     * @brief Summary of the timed batches of a row, in nanoseconds per operation.
+     */
+    struct stats
+    {
+        double dMean;
+        double dP50;
+        double dP90;
+        double dP99;
+    };
+
+    /**
+     * @brief Summarizes the timings of batches.
+     *
+     * @param vecNanoseconds The nanoseconds per operation of each batch, which are sorted.
+     * @return stats The summary.
+     */
+    stats summarize(std::vector<double> &vecNanoseconds)
+    {
+        std::sort(vecNanoseconds.begin(), vecNanoseconds.end());
+        double dSum = 0;
+        for (double d : vecNanoseconds)
+        {
+            dSum += d;
+        }
+        auto const percentile = [&vecNanoseconds](double dRank) { return vecNanoseconds[static_cast<size_t>(dRank * (vecNanoseconds.size() - 1))]; };
+        return { dSum / vecNanoseconds.size(), percentile(0.5), percentile(0.9), percentile(0.99) };
+    }
+
+    /**
+     * @brief Prints a row of the report.
+     *
+     * @param pcName The name of the row.
+     * @param s The summary.
+     */
+    void print_row(char const *pcName, stats const &s)
+    {
+        std::printf("%-44s %9.1f %9.1f %9.1f %9.1f\n", pcName, s.dMean, s.dP50, s.dP90, s.dP99);
+    }
+
+    /**
+     * @brief Prints the header of a section of the report.
+     *
+     * @param pcTitle The title of the section.
+     */
+    void print_header(char const *pcTitle)
+    {
+        std::printf("\n%-44s %9s %9s %9s %9s\n", pcTitle, "ns/op", "p50", "p90", "p99");
+    }
+
+    /**
+     * @brief Times batches of operations.
+     *
+     * @tparam Tsetup The type of the untimed setup before each batch.
+     * @tparam Tbatch The type of a batch, which returns the number of operations it performed.
+     * @param fnSetup The untimed setup.
+     * @param fnBatch The batch.
+     * @return stats The summary.
+     */
+    template <typename Tsetup, typename Tbatch>
+    stats measure(Tsetup &&fnSetup, Tbatch &&fnBatch)
+    {
+        std::vector<double> vecNanoseconds;
+        vecNanoseconds.reserve(g_zuRepetitions);
+        for (size_t zuRepetition = 0; zuRepetition < g_zuRepetitions + 1; ++zuRepetition)
+        {
+            fnSetup();
+            clock_type::time_point const tpBegin = clock_type::now();
+            size_t const zuOps = fnBatch();
+            clock_type::time_point const tpEnd = clock_type::now();
+            if (zuRepetition > 0 && zuOps > 0) // the first batch warms up the caches
+            {
+                vecNanoseconds.push_back(std::chrono::duration<double, std::nano>(tpEnd - tpBegin).count() / zuOps);
+            }
+        }
+        return summarize(vecNanoseconds);
+    }
+
+    /**
+     * @brief Times operator() with the given arguments, filling an empty logger in each batch.
+     *
+     * @tparam Tlogger The type of the logger.
+     * @tparam Targs The types of the format string and the arguments.
+     * @param pcName The name of the row.
+     * @param tArgs The format string and the arguments.
+     */
+    template <typename Tlogger, typename... Targs>
+    void bench_log(char const *pcName, Targs... tArgs)
+    {
+        std::unique_ptr<Tlogger> pLogger(new Tlogger);
+        pLogger->drain([](char const *, va_list) { return 0; });
+        size_t const zuDropped = pLogger->dropped();
+        size_t zuFit = 0;
+        for (; pLogger->dropped() == zuDropped; ++zuFit)
+        {
+            (*pLogger)(tArgs...);
+        }
+        size_t const zuOps = (std::min)(zuFit - 1, size_t(1000)); // the log entries that fit, up to a batch
+        print_row(pcName, measure(
+            [&]() { pLogger->drain([](char const *, va_list) { return 0; }); },
+            [&]() {
+                for (size_t zuOp = 0; zuOp < zuOps; ++zuOp)
+                {
+                    (*pLogger)(tArgs...);
+                }
+                return zuOps;
+            }));
+    }
+
+    /**
+     * @brief Times operator() for a range of argument counts and types.
+     *
+     * @tparam Tlogger The type of the logger, which must use overflow_drop.
+     * @param pcTitle The title of the section.
+     */
+    template <typename Tlogger>
+    void bench_log_all(char const *pcTitle)
+    {
+        print_header(pcTitle);
+        bench_log<Tlogger>("no arguments", "hello, world\n");
+        bench_log<Tlogger>("1 int", "id=%d\n", 42);
+        bench_log<Tlogger>("3 ints", "%d %d %d\n", 1, 2, 3);
+        bench_log<Tlogger>("6 ints", "%d %d %d %d %d %d\n", 1, 2, 3, 4, 5, 6);
+        bench_log<Tlogger>("int, double, string, pointer", "%d %f %s %p\n", 42, 3.14, "worker", static_cast<void *>(nullptr));
+        bench_log<Tlogger>("long long, long double", "%lld %Lf\n", 1234567890123LL, 2.5L);
+        bench_log<Tlogger>("DEFERRED_PRINTF_FORMAT, 3 ints", DEFERRED_PRINTF_FORMAT("%d %d %d\n"), 1, 2, 3);
+        bench_log<Tlogger>("copy_string, 16 characters", "%s\n", jrmwng::copy_string("0123456789abcdef"));
+    }
+
+    /**
+     * @brief Times the direct formatting that deferred logging replaces.
+     */
+    void bench_snprintf()
+    {
+        print_header("direct formatting, for comparison");
+        char acBuffer[256];
+        size_t const zuOps = 1000;
+        print_row("snprintf, int, double, string, pointer", measure([]() {}, [&]() {
+            for (size_t zuOp = 0; zuOp < zuOps; ++zuOp)
+            {
+                std::snprintf(acBuffer, sizeof(acBuffer), "%d %f %s %p\n", static_cast<int>(zuOp), 3.14, "worker", static_cast<void *>(acBuffer));
+            }
+            return zuOps;
+        }));
+        print_row("snprintf, 3 ints", measure([]() {}, [&]() {
+            for (size_t zuOp = 0; zuOp < zuOps; ++zuOp)
+            {
+                std::snprintf(acBuffer, sizeof(acBuffer), "%d %d %d\n", static_cast<int>(zuOp), 2, 3);
+            }
+            return zuOps;
+        }));
+    }
+
+    /**
+     * @brief Times the construction and destruction of loggers with a large buffer on the heap, which is left uninitialized.
+     */
+    void bench_construct()
+    {
+        print_header("construction of a logger, per logger");
+        print_row("64 MB buffer", measure([]() {}, []() {
+            jrmwng::deferred_printf<64 << 20> logger;
+            logger("id=%d\n", 42);
+            return size_t(1);
+        }));
+        print_row("64 MB buffer, concurrent (zeroed)", measure([]() {}, []() {
+            jrmwng::deferred_printf<64 << 20, true> logger;
+            logger("id=%d\n", 42);
+            return size_t(1);
+        }));
+    }
+
+    /**
+     * @brief Times the replay of a full logger into several sinks.
+     */
+    void bench_apply()
+    {
+        using logger_t = jrmwng::deferred_printf<1 << 20, false, jrmwng::overflow_drop>;
+        std::unique_ptr<logger_t> pLogger(new logger_t);
+        size_t zuEntries = 0;
+        for (int i = 0; pLogger->dropped() == 0; ++i)
+        {
+            (*pLogger)("id=%d name=%s value=%#x ratio=%.3f\n", i, "worker", i * 7, i / 3.0);
+            ++zuEntries;
+        }
+        --zuEntries;
+
+        print_header("apply() of a full 1 MB logger, per entry");
+        char acBuffer[256];
+        print_row("apply, vsnprintf to memory", measure([]() {}, [&]() {
+            pLogger->apply([&acBuffer](char const *pcFormat, va_list vaArgs) { return std::vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs); });
+            return zuEntries;
+        }));
+        print_row("format, native formatter to memory", measure([]() {}, [&]() {
+            pLogger->format(acBuffer, sizeof(acBuffer), [](char const *, size_t zuLength) { return static_cast<int>(zuLength); });
+            return zuEntries;
+        }));
+
+#if defined(_WIN32)
+        char const *pcNull = "NUL";
+#else
+        char const *pcNull = "/dev/null";
+#endif
+        std::FILE *pNull = std::fopen(pcNull, "wb");
+        if (pNull)
+        {
+            print_row("apply, vfprintf to the null device", measure([]() {}, [&]() {
+                pLogger->apply(&vfprintf, pNull);
+                std::fflush(pNull);
+                return zuEntries;
+            }));
+            print_row("apply, fd sink to the null device", measure([]() {}, [&]() {
+                jrmwng::deferred_printf_fd_sink sink(fileno(pNull));
+                pLogger->apply(sink);
+                return zuEntries;
+            }));
+            print_row("write_all, fd sink to the null device", measure([]() {}, [&]() {
+                jrmwng::deferred_printf_fd_sink sink(fileno(pNull));
+                sink.write_all(*pLogger);
+                return zuEntries;
+            }));
+            std::fclose(pNull);
+        }
+
+        if (std::FILE *pFile = std::tmpfile())
+        {
+            print_row("apply, vfprintf to a file", measure([&]() { std::rewind(pFile); }, [&]() {
+                pLogger->apply(&vfprintf, pFile);
+                std::fflush(pFile);
+                return zuEntries;
+            }));
+            print_row("write_all, fd sink to a file", measure([&]() { std::rewind(pFile); }, [&]() {
+                jrmwng::deferred_printf_fd_sink sink(fileno(pFile));
+                sink.write_all(*pLogger);
+                return zuEntries;
+            }));
+            std::fclose(pFile);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        g_zuRepetitions = (std::max)(std::strtoul(argv[1], nullptr, 10), 1ul);
+    }
+
+    bench_log_all<jrmwng::deferred_printf<4000, false, jrmwng::overflow_drop>>("operator(), capacity 4000");
+    bench_log_all<jrmwng::deferred_printf<1 << 16, false, jrmwng::overflow_drop>>("operator(), capacity 64 KB");
+    bench_log_all<jrmwng::deferred_printf<1 << 16, true, jrmwng::overflow_drop>>("operator(), concurrent, capacity 64 KB");
+    bench_snprintf();
+    bench_construct();
+    bench_apply();
+    return 0;
+}
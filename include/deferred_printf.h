@@ -6,323 +6,3467 @@
 /// @author jrmwng
 
 #include <functional> // for std::function
-#include <tuple> // for std::tuple, std::apply
+#include <memory> // for std::addressof, std::allocator, std::allocator_traits, std::unique_ptr
+#include <new> // for std::nothrow
+#include <memory_resource> // for std::pmr::polymorphic_allocator
+#include <tuple> // for std::tuple, std::tuple_element_t
+#include <utility> // for std::index_sequence
 #include <cstdarg> // for va_list, va_start, va_end
+#include <cstdio> // for std::snprintf
 #include <stdexcept> // for std::bad_alloc
+#include <string_view> // for std::string_view
 #include <type_traits> // for std::conditional_t
 #include <vector>
 #include <array>
+#include <atomic> // for std::atomic
+#include <cstddef> // for std::max_align_t
+#include <cstdint> // for uint32_t
+#include <algorithm> // for std::min
+#include <cstring> // for std::memset
+#include <thread> // for std::this_thread::yield
+#include <mutex> // for std::mutex
+#include <unordered_map> // for std::unordered_map
+#include <chrono> // for std::chrono::steady_clock, std::chrono::system_clock
+#include <ctime> // for clock_gettime
+#include <cmath> // for std::llround
+#include <cerrno> // for errno
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h> // for __rdtsc
+#define DEFERRED_PRINTF_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // for __rdtsc
+#define DEFERRED_PRINTF_HAS_RDTSC 1
+#endif
+
+/**
+ * @brief Makes a format string that deferred_printf parses and checks at compile time, e.g. `dp(DEFERRED_PRINTF_FORMAT("%d items"), nItems)`.
+ * 
+ * @param format The format string, which must be a string literal.
+ */
+#define DEFERRED_PRINTF_FORMAT(format) \
+    ([]() { struct Sformat : ::jrmwng::details::format_string { constexpr static char const *value() noexcept { return format; } }; return Sformat(); }())
+
+/**
+ * @brief The minimum severity compiled in: 0 trace, 1 debug, 2 info, 3 warn, 4 error. Calls below it, e.g. `dp.trace(...)`, log nothing,
+ *        although their arguments are still evaluated; DEFERRED_PRINTF_LOG does not evaluate them.
+ */
+#ifndef DEFERRED_PRINTF_MIN_SEVERITY
+#define DEFERRED_PRINTF_MIN_SEVERITY 0
+#endif
+
+/**
+ * @brief Logs a new entry with a severity, evaluating the format string and the arguments only if the severity is compiled in and not below
+ *        the runtime threshold, e.g. `DEFERRED_PRINTF_LOG(dp, trace, "%d\n", expensive())`.
+ * 
+ * @param logger The deferred_printf object.
+ * @param level The severity: trace, debug, info, warn or error.
+ * @param ... The format string, possibly made by DEFERRED_PRINTF_FORMAT, and the arguments.
+ */
+#define DEFERRED_PRINTF_LOG(logger, level, ...) \
+    do \
+    { \
+        if constexpr (::jrmwng::details::compiled_in<::jrmwng::severity::level>()) \
+        { \
+            if (::jrmwng::severity::level >= ::jrmwng::severity_threshold()) \
+            { \
+                (logger).template log<::jrmwng::severity::level>(__VA_ARGS__); \
+            } \
+        } \
+    } \
+    while (false)
 
 namespace jrmwng
 {
+    class deferred_printf_page_pool;
+
     namespace details
     {
         /**
-         * @brief Wrapper for vprintf-like functions.
-         * 
-         * @tparam Tvprintf The type of the vprintf-like function.
+         * @brief Header of a heap-allocated chunk of a segmented logger; the log entries follow the header.
          */
-        template <typename Tvprintf>
-        struct vprintf_wrapper
+        struct alignas(std::max_align_t) deferred_printf_chunk
         {
-            Tvprintf fnVprintf;
+            deferred_printf_chunk *pNext;
+            size_t zuLength;
+            size_t zuCapacity;
 
             /**
-             * @brief Calls the wrapped vprintf-like function with the provided format string and arguments.
+             * @brief Returns the log entries of the chunk.
              * 
-             * @param pcFormat The format string.
-             * @param ... The arguments.
-             * @return int The result of the vprintf-like function.
+             * @return char * The log entries.
              */
-            int operator() (char const *pcFormat, ...) const;
+            char *data() const noexcept
+            {
+                return reinterpret_cast<char *>(const_cast<deferred_printf_chunk *>(this + 1));
+            }
         };
 
         /**
-         * @brief Wraps a vprintf-like function in a vprintf_wrapper.
-         * 
-         * @tparam Tvprintf The type of the vprintf-like function.
-         * @param fnVprintf The vprintf-like function.
-         * @return vprintf_wrapper<Tvprintf> The wrapped vprintf-like function.
-         */
-        template <typename Tvprintf>
-        vprintf_wrapper<Tvprintf> wrap_vprintf(Tvprintf && fnVprintf)
-        {
-            return { std::forward<Tvprintf>(fnVprintf) };
-        }
-
-        /**
-         * @brief Abstract base class for deferred log entries.
+         * @brief Singly linked list of chunks, owned by a segmented logger.
+         * @details Chunks are pages taken from a deferred_printf_page_pool, except that a log entry larger than a page gets a chunk of its own.
          */
-        struct Ideferred_printf_log
+        class deferred_printf_chunk_list
         {
-            virtual ~Ideferred_printf_log() = default;
+            deferred_printf_page_pool *m_pPool;
+            deferred_printf_chunk *m_pHead;
+            deferred_printf_chunk *m_pTail;
+        public:
+            explicit deferred_printf_chunk_list(deferred_printf_page_pool *pPool = nullptr) noexcept;
+            deferred_printf_chunk_list(deferred_printf_chunk_list &&other) noexcept;
+            deferred_printf_chunk_list &operator=(deferred_printf_chunk_list &&other) noexcept;
+            ~deferred_printf_chunk_list() noexcept;
 
             /**
-             * @brief Applies the provided vprintf-like function to the log entry.
+             * @brief Reserves space in the last chunk, appending a new chunk when it does not fit.
              * 
-             * @param fnVprintf The vprintf-like function.
-             * @return int The result of the vprintf-like function.
+             * @param zuSize The size of the space.
+             * @return char * The reserved space, or nullptr if a new chunk cannot be allocated.
              */
-            virtual int apply(std::function<int(char const *, va_list)> const &fnVprintf) const = 0;
+            char *reserve(size_t zuSize) noexcept;
 
             /**
-             * @brief Gets the size of the log entry.
-             * 
-             * @return size_t The size of the log entry.
+             * @brief Returns all chunks to the page pool.
              */
-            virtual size_t size() const = 0;
+            void clear() noexcept;
+
+            deferred_printf_page_pool *pool() const noexcept { return m_pPool; }
+            void set_pool(deferred_printf_page_pool *pPool) noexcept { m_pPool = pPool; }
+            bool empty() const noexcept { return m_pHead == nullptr; }
+            deferred_printf_chunk const *head() const noexcept { return m_pHead; }
+            deferred_printf_chunk const *tail() const noexcept { return m_pTail; }
         };
+    }
 
+    /**
+     * @brief Thread-safe pool of fixed-size pages for segmented loggers.
+     * @details Pages released by one logger are reused by the next one, so a warm pool grows a logger without touching the heap.
+     */
+    class deferred_printf_page_pool
+    {
+        size_t const m_zuPageSize;
+        mutable std::mutex m_mutex;
+        details::deferred_printf_chunk *m_pFree;
+        size_t m_zuFree;
+    public:
         /**
-         * @brief Template class for deferred log entries.
+         * @brief Constructs an empty page pool.
          * 
-         * @tparam Ttokens The types of the tokens.
+         * @param zuPageSize The number of bytes of log entries per page.
          */
-        template <typename... Ttokens>
-        class Cdeferred_printf_log : public Ideferred_printf_log
+        explicit deferred_printf_page_pool(size_t zuPageSize) noexcept;
+
+        /**
+         * @brief Frees the pages in the pool. Pages still held by loggers must be released before.
+         */
+        ~deferred_printf_page_pool() noexcept;
+
+        deferred_printf_page_pool(deferred_printf_page_pool const &) = delete;
+        deferred_printf_page_pool &operator=(deferred_printf_page_pool const &) = delete;
+
+        /**
+         * @brief Takes a page from the pool, allocating one if the pool is empty.
+         * 
+         * @return details::deferred_printf_chunk * The page, or nullptr if it cannot be allocated.
+         */
+        details::deferred_printf_chunk *acquire() noexcept;
+
+        /**
+         * @brief Returns a page to the pool.
+         * 
+         * @param pPage The page, which must have been acquired from this pool.
+         */
+        void release(details::deferred_printf_chunk *pPage) noexcept;
+
+        /**
+         * @brief Allocates pages up front, so that later growth does not hit the heap.
+         * 
+         * @param zuPages The number of pages to add to the pool.
+         * @return bool True if all pages are allocated.
+         */
+        bool preallocate(size_t zuPages) noexcept;
+
+        /**
+         * @brief Returns the number of bytes of log entries per page.
+         * 
+         * @return size_t The page size.
+         */
+        size_t page_size() const noexcept
         {
-            std::tuple<Ttokens...> m_tupleToken;
-        public:
-            /**
-             * @brief Constructor that initializes the log entry with the provided tokens.
-             * 
-             * @param tTokens The tokens.
-             */
-            Cdeferred_printf_log(Ttokens... tTokens) noexcept
-                : m_tupleToken(tTokens...)
-            {}
+            return m_zuPageSize;
+        }
 
-            /**
-             * @brief Destructor.
-             */
-            ~Cdeferred_printf_log() noexcept override
-            {
-            }
+        /**
+         * @brief Returns the number of pages available in the pool.
+         * 
+         * @return size_t The number of pages.
+         */
+        size_t free_pages() const noexcept;
 
-            /**
-             * @brief Applies the provided vprintf-like function to the log entry.
-             * 
-             * @param fnVprintf The vprintf-like function.
-             * @return int The result of the vprintf-like function.
-             */
-            int apply(std::function<int(char const *, va_list)> const &fnVprintf) const noexcept override
+        /**
+         * @brief Returns the process-wide pool for the given page size.
+         * 
+         * @tparam zuPAGE_SIZE The page size.
+         * @return deferred_printf_page_pool & The pool.
+         */
+        template <size_t zuPAGE_SIZE>
+        static deferred_printf_page_pool &shared()
+        {
+            // Never destroyed, so that loggers with static storage duration can still return their pages at exit
+            static deferred_printf_page_pool *const s_pPool = new deferred_printf_page_pool(zuPAGE_SIZE);
+            return *s_pPool;
+        }
+    };
+
+    /**
+     * @brief Overflow policy that throws std::bad_alloc when a log entry does not fit.
+     */
+    struct overflow_throw
+    {
+        constexpr static bool bNOEXCEPT = false;
+    };
+
+    /**
+     * @brief Overflow policy that turns the logger into a ring buffer (flight recorder).
+     * @details When a log entry does not fit, the oldest log entries are discarded until it does. Log entries never straddle the end of the buffer;
+     *          the logger wraps around to the beginning of the buffer instead, and iteration follows the wrap point.
+     */
+    struct overflow_overwrite
+    {
+        constexpr static bool bNOEXCEPT = true;
+    };
+
+    /**
+     * @brief Overflow policy that drops a log entry that does not fit and counts it; see deferred_printf::dropped().
+     */
+    struct overflow_drop
+    {
+        constexpr static bool bNOEXCEPT = true;
+    };
+
+    /**
+     * @brief Overflow policy that spins until another thread frees space with deferred_printf::drain().
+     * @details It needs a concurrent logger.
+     */
+    struct overflow_block
+    {
+        constexpr static bool bNOEXCEPT = true;
+    };
+
+    /**
+     * @brief Overflow policy that makes the logger a segmented buffer, a linked list of pages taken from a deferred_printf_page_pool.
+     * @details The logger's capacity becomes the page size of the default pool, and the logger has no storage of its own.
+     *          Log entries that are already logged are never moved. If a page cannot be allocated, the log entry is dropped and counted.
+     */
+    struct overflow_grow
+    {
+        constexpr static bool bNOEXCEPT = true;
+
+        details::deferred_printf_chunk_list chunks;
+
+        /**
+         * @brief Takes pages from deferred_printf_page_pool::shared() for the logger's capacity.
+         */
+        overflow_grow() = default;
+
+        /**
+         * @brief Takes pages from the provided pool.
+         * 
+         * @param pool The pool, which must outlive the logger.
+         */
+        explicit overflow_grow(deferred_printf_page_pool &pool) noexcept
+            : chunks(&pool)
+        {}
+    };
+
+    /**
+     * @brief Overflow policy that synchronously replays all log entries through a vprintf-like function and empties the logger.
+     */
+    struct overflow_flush
+    {
+        constexpr static bool bNOEXCEPT = true;
+
+        std::function<int(char const *, va_list)> fnVprintf;
+    };
+
+    /**
+     * @brief Failure policy of deferred_printf::apply_checked() that stops at the first log entry whose callback fails.
+     */
+    struct failure_abort
+    {
+    };
+
+    /**
+     * @brief Failure policy of deferred_printf::apply_checked() that calls the callback again, e.g. after EINTR or EAGAIN, and stops if it keeps failing.
+     */
+    struct failure_retry
+    {
+        size_t zuAttempts = 3; // the number of calls per log entry, including the first one
+    };
+
+    /**
+     * @brief Failure policy of deferred_printf::apply_checked() that records the first failure and carries on with the next log entry.
+     */
+    struct failure_skip
+    {
+    };
+
+    /**
+     * @brief Result of deferred_printf::apply_checked().
+     */
+    struct apply_result
+    {
+        constexpr static size_t zuNONE = ~size_t(0);
+
+        size_t zuBytes = 0; // the sum of the non-negative results of the callback function
+        size_t zuEntries = 0; // the number of log entries replayed successfully
+        size_t zuFailed = zuNONE; // the index of the first log entry whose callback failed, or zuNONE
+        int nErrno = 0; // errno as the callback left it at the first failure
+
+        /**
+         * @brief Returns whether every callback succeeded.
+         */
+        explicit operator bool() const noexcept
+        {
+            return zuFailed == zuNONE;
+        }
+    };
+
+    /**
+     * @brief Statistics of a logger, made by deferred_printf::stats(), e.g. to size its capacity from production data.
+     */
+    struct deferred_printf_stats
+    {
+        constexpr static size_t zuSIZE_CLASSES = 13; // log entries take 8 to 65535 bytes
+
+        size_t zuCapacity = 0; // the capacity of the logger
+        size_t zuEntriesHeld = 0; // the number of log entries held
+        size_t zuBytesHeld = 0; // the bytes of the log entries held
+        size_t zuHighWater = 0; // the most bytes logged between two drains, including those that the ring buffer discarded
+        size_t zuDropped = 0; // the number of log entries dropped by the overflow policy
+        std::array<size_t, zuSIZE_CLASSES> azuSizeHistogram{}; // [i] counts the log entries of 2^(i+3) to 2^(i+4)-1 bytes
+        std::vector<size_t> vecBytesByFormat; // the bytes of the log entries held, indexed by the ID of their format string
+
+        /**
+         * @brief Returns the size class of a log entry in azuSizeHistogram.
+         * 
+         * @param zuSize The size of the log entry.
+         * @return size_t The size class.
+         */
+        static size_t size_class(size_t zuSize) noexcept
+        {
+            size_t zuClass = 0;
+            for (zuSize >>= 4; zuSize != 0 && zuClass + 1 < zuSIZE_CLASSES; zuSize >>= 1)
             {
-                return std::apply(wrap_vprintf(fnVprintf), m_tupleToken);
+                ++zuClass;
             }
+            return zuClass;
+        }
+    };
 
-            /**
-             * @brief Returns the size of the log entry.
-             * 
-             * @return size_t The size of the log entry.
-             */
-            size_t size() const noexcept override
+    /**
+     * @brief Clock policy that records no timestamps; log entries take no space for them.
+     */
+    struct clock_none
+    {
+        constexpr static bool bENABLED = false;
+        constexpr static bool bNANOSECONDS = true;
+
+        static uint64_t now() noexcept
+        {
+            return 0;
+        }
+    };
+
+    /**
+     * @brief Clock policy that records the time stamp counter, which takes a few cycles to read.
+     * @details The ticks are converted into wall-clock time at replay by a measured clock_calibration. It assumes an invariant TSC;
+     *          on processors without one, it falls back to std::chrono::steady_clock.
+     */
+    struct clock_tsc
+    {
+        constexpr static bool bENABLED = true;
+#if defined(DEFERRED_PRINTF_HAS_RDTSC)
+        constexpr static bool bNANOSECONDS = false;
+
+        static uint64_t now() noexcept
+        {
+            return __rdtsc();
+        }
+#else
+        constexpr static bool bNANOSECONDS = std::is_same_v<std::chrono::steady_clock::period, std::nano>;
+
+        static uint64_t now() noexcept
+        {
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+#endif
+    };
+
+    /**
+     * @brief Clock policy that records CLOCK_MONOTONIC_RAW in nanoseconds, or std::chrono::steady_clock where it is not available.
+     */
+    struct clock_monotonic
+    {
+        constexpr static bool bENABLED = true;
+#if defined(CLOCK_MONOTONIC_RAW)
+        constexpr static bool bNANOSECONDS = true;
+
+        static uint64_t now() noexcept
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+        }
+#else
+        constexpr static bool bNANOSECONDS = std::is_same_v<std::chrono::steady_clock::period, std::nano>;
+
+        static uint64_t now() noexcept
+        {
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+#endif
+    };
+
+    /**
+     * @brief Converts the timestamps of a clock policy into wall-clock time, i.e. nanoseconds since the epoch of std::chrono::system_clock.
+     */
+    struct clock_calibration
+    {
+        uint64_t u64Ticks; // a timestamp of the clock
+        int64_t i64Nanoseconds; // the wall-clock time at u64Ticks
+        double dNanosecondsPerTick;
+
+        /**
+         * @brief Calibrates the provided clock policy against the wall clock.
+         * @details A clock that does not count nanoseconds is measured against std::chrono::steady_clock over the provided interval, so calibrate once, e.g. at startup.
+         * 
+         * @tparam Tclock The clock policy.
+         * @param nsInterval The measuring interval.
+         * @return clock_calibration The calibration.
+         */
+        template <typename Tclock>
+        static clock_calibration calibrate(std::chrono::nanoseconds nsInterval = std::chrono::milliseconds(10))
+        {
+            double dNanosecondsPerTick = 1.0;
+            if constexpr (!Tclock::bNANOSECONDS)
             {
-                return sizeof(Cdeferred_printf_log<Ttokens...>);
+                auto const tpBegin = std::chrono::steady_clock::now();
+                uint64_t const u64Begin = Tclock::now();
+                std::this_thread::sleep_for(nsInterval);
+                auto const tpEnd = std::chrono::steady_clock::now();
+                uint64_t const u64End = Tclock::now();
+                dNanosecondsPerTick = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(tpEnd - tpBegin).count()) / static_cast<double>((std::max)(u64End - u64Begin, uint64_t(1)));
             }
-        };
+            uint64_t const u64Ticks = Tclock::now();
+            auto const tpNow = std::chrono::system_clock::now();
+            return { u64Ticks, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tpNow.time_since_epoch()).count()), dNanosecondsPerTick };
+        }
 
         /**
-         * @brief Iterator class for iterating over deferred log entries.
+         * @brief Converts a timestamp into wall-clock time.
          * 
-         * @tparam Tchar The character type of the buffer.
+         * @param u64Timestamp The timestamp.
+         * @return int64_t Nanoseconds since the epoch of std::chrono::system_clock.
          */
-        template <typename Tchar>
-        class deferred_printf_log_iterator
+        int64_t to_nanoseconds(uint64_t u64Timestamp) const noexcept
         {
-            Tchar *m_pBuffer;
-        public:
-            using reference = std::conditional_t<std::is_const_v<Tchar>, Ideferred_printf_log const &, Ideferred_printf_log &>;
+            return i64Nanoseconds + std::llround(static_cast<double>(static_cast<int64_t>(u64Timestamp - u64Ticks)) * dNanosecondsPerTick);
+        }
+    };
 
-            /**
-             * @brief Constructor that initializes the iterator with the provided buffer.
-             * 
-             * @param pcBuffer The buffer.
-             */
-            deferred_printf_log_iterator(Tchar *pcBuffer) noexcept;
+    /**
+     * @brief Severity of a log entry, recorded in its tag by the severity-tagged entry points such as deferred_printf::info().
+     */
+    enum class severity : uint8_t
+    {
+        trace,
+        debug,
+        info,
+        warn,
+        error,
+    };
 
-            /**
-             * @brief Inequality operator.
-             * 
-             * @param other The other iterator.
-             * @return bool True if the iterators are not equal, false otherwise.
-             */
-            bool operator!=(const deferred_printf_log_iterator<Tchar> &other) const noexcept;
+    namespace details
+    {
+        extern std::atomic<severity> g_eSeverityThreshold; // the runtime threshold; see set_severity_threshold()
 
-            /**
-             * @brief Pre-increment operator.
-             * 
-             * @return deferred_printf_log_iterator& The incremented iterator.
-             */
-            deferred_printf_log_iterator<Tchar> &operator++() noexcept;
+        /**
+         * @brief Tells whether a severity is compiled in, i.e. not below DEFERRED_PRINTF_MIN_SEVERITY.
+         * 
+         * @tparam eSEVERITY The severity.
+         * @return bool True if the severity is compiled in.
+         */
+        template <severity eSEVERITY>
+        constexpr bool compiled_in() noexcept
+        {
+            return static_cast<int>(eSEVERITY) >= DEFERRED_PRINTF_MIN_SEVERITY;
+        }
+    }
+
+    /**
+     * @brief Sets the process-wide severity below which the severity-tagged entry points record nothing.
+     * @details It complements DEFERRED_PRINTF_MIN_SEVERITY, which removes the lower levels at compile time.
+     * 
+     * @param eThreshold The threshold.
+     */
+    inline void set_severity_threshold(severity eThreshold) noexcept
+    {
+        details::g_eSeverityThreshold.store(eThreshold, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the process-wide severity threshold.
+     * 
+     * @return severity The threshold.
+     */
+    inline severity severity_threshold() noexcept
+    {
+        return details::g_eSeverityThreshold.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief String argument that is copied into the log entry, made by copy_string().
+     * @details A `%s` argument is normally stored by pointer, so its buffer must outlive the logger. A copied string is stored inline,
+     *          length-prefixed, so copying it costs a memcpy and its buffer may be reused right after logging.
+     */
+    struct copied_string
+    {
+        constexpr static size_t zuMAX_LENGTH = 4096;
+        constexpr static size_t zuMAX_MARKER = 15;
+
+        char const *pcString; // nullptr is logged as a null pointer
+        uint16_t u16Length; // the number of characters to copy
+        uint8_t u8Marker; // the length of the truncation marker, or 0 if the string is not truncated
+        char const *pcMarker;
+
+        /**
+         * @brief Returns the number of bytes that the string takes in the log entry, including its null terminator.
+         * 
+         * @return size_t The number of bytes.
+         */
+        size_t inline_size() const noexcept
+        {
+            return pcString ? u16Length + u8Marker + 1 : 0;
+        }
+    };
+
+    /**
+     * @brief Makes a string argument that is copied into the log entry, e.g. `dp("%s", jrmwng::copy_string(str.c_str()))`.
+     * @details The string must be null-terminated, since up to `zuMaxLength + 1` characters are read to tell whether it is truncated;
+     *          use the std::string_view overload for a buffer that is not.
+     * 
+     * @param pcString The null-terminated string.
+     * @param zuMaxLength The maximum number of characters to copy, at most copied_string::zuMAX_LENGTH.
+     * @param pcMarker The marker appended to a truncated string, at most copied_string::zuMAX_MARKER characters; nullptr for none.
+     * @return copied_string The string argument.
+     */
+    inline copied_string copy_string(char const *pcString, size_t zuMaxLength = 255, char const *pcMarker = "...") noexcept
+    {
+        zuMaxLength = (std::min)(zuMaxLength, copied_string::zuMAX_LENGTH);
+        size_t const zuLength = pcString ? strnlen(pcString, zuMaxLength + 1) : 0;
+        bool const bTruncated = zuLength > zuMaxLength;
+        return {
+            pcString,
+            static_cast<uint16_t>((std::min)(zuLength, zuMaxLength)),
+            static_cast<uint8_t>(bTruncated && pcMarker ? strnlen(pcMarker, copied_string::zuMAX_MARKER) : 0),
+            pcMarker ? pcMarker : "", // never a null source for memcpy
+        };
+    }
+
+    /**
+     * @brief Makes a string argument that is copied into the log entry from a buffer of known length, which need not be null-terminated,
+     *        e.g. `dp("%s", jrmwng::copy_string(std::string_view(acName, zuName)))`.
+     * @details No character beyond the length of the buffer is read. A null character within the buffer ends the copied string.
+     * 
+     * @param svString The string; a null data pointer is logged as a null pointer.
+     * @param zuMaxLength The maximum number of characters to copy, at most copied_string::zuMAX_LENGTH.
+     * @param pcMarker The marker appended to a truncated string, at most copied_string::zuMAX_MARKER characters; nullptr for none.
+     * @return copied_string The string argument.
+     */
+    inline copied_string copy_string(std::string_view svString, size_t zuMaxLength = 255, char const *pcMarker = "...") noexcept
+    {
+        zuMaxLength = (std::min)(zuMaxLength, copied_string::zuMAX_LENGTH);
+        size_t const zuLength = svString.data() ? strnlen(svString.data(), (std::min)(svString.size(), zuMaxLength + 1)) : 0;
+        bool const bTruncated = zuLength > zuMaxLength;
+        return {
+            svString.data(),
+            static_cast<uint16_t>((std::min)(zuLength, zuMaxLength)),
+            static_cast<uint8_t>(bTruncated && pcMarker ? strnlen(pcMarker, copied_string::zuMAX_MARKER) : 0),
+            pcMarker ? pcMarker : "",
+        };
+    }
+
+    namespace details
+    {
+        /**
+         * @brief Non-owning reference to a vprintf-like function.
+         * @details Unlike std::function, it never allocates, and calling it costs a single indirect call.
+         *          The referenced function must outlive the reference.
+         */
+        class vprintf_ref
+        {
+            void *m_pObject;
+            int (*m_pfnCall)(void *pObject, char const *pcFormat, va_list vaArgs);
+        public:
+            /**
+             * @brief Constructor that refers to the provided vprintf-like function.
+             * 
+             * @tparam Tvprintf The type of the vprintf-like function.
+             * @param fnVprintf The vprintf-like function.
+             */
+            template <typename Tvprintf, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Tvprintf>, vprintf_ref>>>
+            vprintf_ref(Tvprintf && fnVprintf) noexcept
+                : m_pObject(const_cast<void *>(static_cast<void const volatile *>(std::addressof(fnVprintf))))
+                , m_pfnCall([](void *pObject, char const *pcFormat, va_list vaArgs) -> int
+                {
+                    return (*static_cast<std::remove_reference_t<Tvprintf> *>(pObject))(pcFormat, vaArgs);
+                })
+            {}
+
+            /**
+             * @brief Calls the referenced vprintf-like function.
+             * 
+             * @param pcFormat The format string.
+             * @param vaArgs The arguments.
+             * @return int The result of the vprintf-like function.
+             */
+            int operator() (char const *pcFormat, va_list vaArgs) const
+            {
+                return m_pfnCall(m_pObject, pcFormat, vaArgs);
+            }
+        };
+
+        /**
+         * @brief Wrapper for vprintf-like functions.
+         * 
+         * @tparam Tvprintf The type of the vprintf-like function.
+         */
+        template <typename Tvprintf>
+        struct vprintf_wrapper
+        {
+            Tvprintf fnVprintf;
+
+            /**
+             * @brief Calls the wrapped vprintf-like function with the provided format string and arguments.
+             * 
+             * @param pcFormat The format string.
+             * @param ... The arguments.
+             * @return int The result of the vprintf-like function.
+             */
+            int operator() (char const *pcFormat, ...) const;
+        };
+
+        /**
+         * @brief Wraps a vprintf-like function in a vprintf_wrapper.
+         * 
+         * @tparam Tvprintf The type of the vprintf-like function.
+         * @param fnVprintf The vprintf-like function.
+         * @return vprintf_wrapper<Tvprintf> The wrapped vprintf-like function.
+         */
+        template <typename Tvprintf>
+        vprintf_wrapper<Tvprintf> wrap_vprintf(Tvprintf && fnVprintf)
+        {
+            return { std::forward<Tvprintf>(fnVprintf) };
+        }
+
+        /**
+         * @brief Typed argument of the native formatter.
+         */
+        struct format_arg
+        {
+            enum class type : uint8_t
+            {
+                sint,
+                uint,
+                dbl,
+                ldbl,
+                str,
+                ptr,
+                inline_str, // only in token descriptors: a string stored in the log entry, see inline_string
+            };
+
+            type eType;
+            uint8_t u8Size; // the size of an integer argument, so that e.g. `%x` of a negative int prints 32 bits
+            union
+            {
+                long long ll;
+                unsigned long long ull;
+                double d;
+                long double ld;
+                char const *pc;
+                void const *pv;
+            };
+        };
+
+        /**
+         * @brief Token of a string copied into the log entry; it refers to the characters by their offset from the beginning of the log entry.
+         */
+        struct inline_string
+        {
+            uint16_t u16Offset; // 0 for a null pointer
+            uint16_t u16Length;
+        };
+
+        /**
+         * @brief The type of the token that stores an argument of the given type.
+         */
+        template <typename Targ>
+        using stored_t = std::conditional_t<std::is_same_v<Targ, copied_string>, inline_string, Targ>;
+
+        /**
+         * @brief Returns the number of bytes that an argument takes in the log entry beyond its token.
+         */
+        template <typename Targ>
+        size_t inline_size(Targ const &tArg) noexcept
+        {
+            if constexpr (std::is_same_v<Targ, copied_string>)
+            {
+                return tArg.inline_size();
+            }
+            else
+            {
+                return 0;
+            }
+        }
+
+        /**
+         * @brief Makes the token of an argument, copying a copied_string into the log entry.
+         * 
+         * @param tArg The argument.
+         * @param pcEntry The log entry.
+         * @param zuInline The offset at which the next string is copied, which is advanced past the copied string.
+         * @return stored_t<Targ> The token.
+         */
+        template <typename Targ>
+        stored_t<Targ> store_token(Targ const &tArg, char *pcEntry, size_t &zuInline) noexcept
+        {
+            if constexpr (std::is_same_v<Targ, copied_string>)
+            {
+                if (tArg.pcString == nullptr)
+                {
+                    return inline_string{ 0, 0 };
+                }
+                inline_string const token = { static_cast<uint16_t>(zuInline), static_cast<uint16_t>(tArg.u16Length + tArg.u8Marker) };
+                std::memcpy(pcEntry + zuInline, tArg.pcString, tArg.u16Length);
+                std::memcpy(pcEntry + zuInline + tArg.u16Length, tArg.pcMarker, tArg.u8Marker);
+                pcEntry[zuInline + token.u16Length] = '\0';
+                zuInline += tArg.inline_size();
+                return token;
+            }
+            else
+            {
+                return tArg;
+            }
+        }
+
+        /**
+         * @brief Turns a token back into the argument that vprintf-like functions take.
+         * 
+         * @param pcEntry The log entry.
+         * @param tToken The token.
+         * @return The argument.
+         */
+        template <typename Ttoken>
+        auto resolve_token(char const *pcEntry, Ttoken tToken) noexcept
+        {
+            if constexpr (std::is_same_v<Ttoken, inline_string>)
+            {
+                return tToken.u16Offset ? pcEntry + tToken.u16Offset : static_cast<char const *>(nullptr);
+            }
+            else
+            {
+                return tToken;
+            }
+        }
+
+        /**
+         * @brief Returns the format_arg type of the provided argument type.
+         * 
+         * @tparam Targ The type of the argument.
+         * @return format_arg::type The format_arg type.
+         */
+        template <typename Targ>
+        constexpr format_arg::type format_arg_type() noexcept
+        {
+            if constexpr (std::is_same_v<Targ, inline_string>)
+            {
+                return format_arg::type::inline_str;
+            }
+            else if constexpr (std::is_same_v<Targ, long double>)
+            {
+                return format_arg::type::ldbl;
+            }
+            else if constexpr (std::is_floating_point_v<Targ>)
+            {
+                return format_arg::type::dbl;
+            }
+            else if constexpr (std::is_integral_v<Targ> && std::is_signed_v<Targ>)
+            {
+                return format_arg::type::sint;
+            }
+            else if constexpr (std::is_integral_v<Targ> || std::is_enum_v<Targ>)
+            {
+                return format_arg::type::uint;
+            }
+            else if constexpr (std::is_convertible_v<Targ, char const *>)
+            {
+                return format_arg::type::str;
+            }
+            else
+            {
+                static_assert(std::is_pointer_v<Targ> || std::is_null_pointer_v<Targ>, "Unsupported argument type");
+                return format_arg::type::ptr;
+            }
+        }
+
+        /**
+         * @brief Makes a format_arg of the provided argument.
+         * 
+         * @tparam Targ The type of the argument.
+         * @param tArg The argument.
+         * @return format_arg The format_arg.
+         */
+        template <typename Targ>
+        format_arg make_format_arg(Targ tArg) noexcept
+        {
+            constexpr format_arg::type eTYPE = format_arg_type<Targ>();
+
+            format_arg arg;
+            arg.eType = eTYPE;
+            arg.u8Size = static_cast<uint8_t>(sizeof(Targ));
+            if constexpr (eTYPE == format_arg::type::ldbl)
+            {
+                arg.ld = tArg;
+            }
+            else if constexpr (eTYPE == format_arg::type::dbl)
+            {
+                arg.d = tArg;
+            }
+            else if constexpr (eTYPE == format_arg::type::sint)
+            {
+                arg.ll = tArg;
+            }
+            else if constexpr (eTYPE == format_arg::type::uint)
+            {
+                arg.ull = static_cast<unsigned long long>(tArg);
+            }
+            else if constexpr (eTYPE == format_arg::type::str)
+            {
+                arg.pc = tArg;
+            }
+            else
+            {
+                arg.pv = tArg;
+            }
+            return arg;
+        }
+
+        /**
+         * @brief Formats the provided arguments like snprintf, without going through a va_list.
+         * @details Integers, characters, strings and pointers are formatted natively; floating-point conversions are delegated to snprintf one at a time.
+         * 
+         * @param pcOutput The output buffer, which is always null-terminated unless zuSize is 0.
+         * @param zuSize The size of the output buffer.
+         * @param pcFormat The format string.
+         * @param pArgs The arguments.
+         * @param zuArgs The number of arguments.
+         * @return int The number of characters that would have been written if the output buffer were large enough, excluding the null terminator.
+         */
+        int format_args(char *pcOutput, size_t zuSize, char const *pcFormat, format_arg const *pArgs, size_t zuArgs) noexcept;
+
+        /**
+         * @brief Parsed conversion specification of a format string.
+         */
+        struct format_spec
+        {
+            bool bLeft = false;
+            bool bPlus = false;
+            bool bSpace = false;
+            bool bAlternate = false;
+            bool bZero = false;
+            bool bWidthArg = false; // the width is taken from an argument
+            bool bPrecisionArg = false; // the precision is taken from an argument
+            bool bLongDouble = false;
+            size_t zuWidth = 0;
+            int nPrecision = -1;
+            size_t zuLength = 0; // the size implied by the length modifier, or 0 if there is none
+            char cConversion = 0; // 0 if the format string ends within the conversion specification
+        };
+
+        /**
+         * @brief Parses a conversion specification.
+         * 
+         * @param pc Pointer just past the '%'.
+         * @param spec The parsed conversion specification.
+         * @return char const * Pointer just past the conversion specification.
+         */
+        constexpr char const *parse_format_spec(char const *pc, format_spec &spec) noexcept
+        {
+            for (;; ++pc)
+            {
+                if (*pc == '-') spec.bLeft = true;
+                else if (*pc == '+') spec.bPlus = true;
+                else if (*pc == ' ') spec.bSpace = true;
+                else if (*pc == '#') spec.bAlternate = true;
+                else if (*pc == '0') spec.bZero = true;
+                else break;
+            }
+            if (*pc == '*')
+            {
+                spec.bWidthArg = true;
+                ++pc;
+            }
+            for (; *pc >= '0' && *pc <= '9'; ++pc)
+            {
+                spec.zuWidth = spec.zuWidth * 10 + (*pc - '0');
+            }
+            if (*pc == '.')
+            {
+                ++pc;
+                spec.nPrecision = 0;
+                if (*pc == '*')
+                {
+                    spec.bPrecisionArg = true;
+                    ++pc;
+                }
+                for (; *pc >= '0' && *pc <= '9'; ++pc)
+                {
+                    spec.nPrecision = spec.nPrecision * 10 + (*pc - '0');
+                }
+            }
+            switch (*pc)
+            {
+            case 'h':
+                spec.zuLength = (pc[1] == 'h') ? (++pc, sizeof(char)) : sizeof(short);
+                ++pc;
+                break;
+            case 'l':
+                spec.zuLength = (pc[1] == 'l') ? (++pc, sizeof(long long)) : sizeof(long);
+                ++pc;
+                break;
+            case 'j':
+                spec.zuLength = sizeof(intmax_t);
+                ++pc;
+                break;
+            case 'z':
+                spec.zuLength = sizeof(size_t);
+                ++pc;
+                break;
+            case 't':
+                spec.zuLength = sizeof(ptrdiff_t);
+                ++pc;
+                break;
+            case 'L':
+                spec.bLongDouble = true;
+                ++pc;
+                break;
+            }
+            if (*pc != '\0')
+            {
+                spec.cConversion = *pc++;
+            }
+            return pc;
+        }
+
+        /**
+         * @brief One step of a precomputed format plan: literal text followed by a conversion.
+         */
+        struct format_directive
+        {
+            size_t zuText; // the offset of the literal text in the format string
+            size_t zuTextLength;
+            size_t zuSpecLength; // the length of the conversion specification, including the '%', which follows the literal text
+            format_spec spec; // the conversion, whose cConversion is 0 for the trailing literal text
+        };
+
+        /**
+         * @brief Counts the directives of a format string, i.e. its conversions and its trailing literal text.
+         * 
+         * @param pcFormat The format string.
+         * @return size_t The number of directives.
+         */
+        constexpr size_t count_format_directives(char const *pcFormat) noexcept
+        {
+            size_t zuDirectives = 1;
+            for (char const *pc = pcFormat; *pc; )
+            {
+                if (*pc++ == '%')
+                {
+                    format_spec spec;
+                    pc = parse_format_spec(pc, spec);
+                    ++zuDirectives;
+                }
+            }
+            return zuDirectives;
+        }
+
+        /**
+         * @brief Parses a format string into directives.
+         * 
+         * @tparam zuDIRECTIVES The number of directives, as returned by count_format_directives().
+         * @param pcFormat The format string.
+         * @return std::array<format_directive, zuDIRECTIVES> The directives.
+         */
+        template <size_t zuDIRECTIVES>
+        constexpr std::array<format_directive, zuDIRECTIVES> parse_format_directives(char const *pcFormat) noexcept
+        {
+            std::array<format_directive, zuDIRECTIVES> aDirectives{};
+            size_t zuDirective = 0;
+            char const *pcText = pcFormat;
+            for (char const *pc = pcFormat; ; )
+            {
+                if (*pc == '\0')
+                {
+                    aDirectives[zuDirective] = { static_cast<size_t>(pcText - pcFormat), static_cast<size_t>(pc - pcText), 0, format_spec() };
+                    break;
+                }
+                if (*pc != '%')
+                {
+                    ++pc;
+                    continue;
+                }
+                format_directive &directive = aDirectives[zuDirective++];
+                directive.zuText = static_cast<size_t>(pcText - pcFormat);
+                directive.zuTextLength = static_cast<size_t>(pc - pcText);
+                char const *pcSpec = pc;
+                pc = parse_format_spec(pc + 1, directive.spec);
+                directive.zuSpecLength = static_cast<size_t>(pc - pcSpec);
+                pcText = pc;
+            }
+            return aDirectives;
+        }
+
+        /**
+         * @brief Checks an argument against the conversion that consumes it.
+         * 
+         * @tparam Targ The type of the argument.
+         * @param spec The conversion specification.
+         * @param bStar Whether the argument is a width or a precision taken by `*`.
+         * @return true if the argument matches the conversion, false otherwise.
+         */
+        template <typename Targ>
+        constexpr bool format_arg_matches(format_spec const &spec, bool bStar) noexcept
+        {
+            constexpr bool bINTEGER = std::is_integral_v<Targ> || std::is_enum_v<Targ>;
+            if (bStar)
+            {
+                return bINTEGER && sizeof(Targ) <= sizeof(int);
+            }
+            switch (spec.cConversion)
+            {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+                return bINTEGER && (spec.zuLength > sizeof(int) ? sizeof(Targ) == spec.zuLength : sizeof(Targ) <= sizeof(int)); // arguments narrower than int are promoted
+            case 's':
+                return std::is_convertible_v<Targ, char const *> || std::is_same_v<Targ, inline_string>;
+            case 'p':
+                return std::is_pointer_v<Targ> || std::is_null_pointer_v<Targ>;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                return std::is_floating_point_v<Targ> && (std::is_same_v<Targ, long double> == spec.bLongDouble);
+            default:
+                return false; // including %n, which is never written through
+            }
+        }
+
+        /**
+         * @brief Interns a format string.
+         * 
+         * @param pcFormat The format string, which must outlive the process-wide registry, e.g. a string literal.
+         * @return uint32_t The ID of the format string, which is shared by all format strings with the same contents.
+         */
+        uint32_t intern_format(char const *pcFormat) noexcept;
+
+        /**
+         * @brief Interns a copy of a format string whose contents are not interned yet, e.g. one built at run time.
+         * @details The copy lives as long as the process-wide registry, so the format string itself may be freed afterwards. Repeated
+         *          queries for the same format string are answered from a per-thread cache, without the lock of the registry.
+         * 
+         * @param pcFormat The format string.
+         * @return uint32_t The ID of the format string, which is shared by all format strings with the same contents.
+         * @throws std::bad_alloc If the copy cannot be allocated.
+         */
+        uint32_t intern_format_copy(char const *pcFormat);
+
+        /**
+         * @brief Returns an interned format string.
+         * 
+         * @param u32Id The ID returned by intern_format() or intern_format_copy().
+         * @return char const * The format string.
+         */
+        char const *interned_format(uint32_t u32Id) noexcept;
+
+        /**
+         * @brief Returns the number of interned format strings, which bounds their IDs.
+         * 
+         * @return size_t The number of interned format strings.
+         */
+        size_t interned_format_count() noexcept;
+
+        /**
+         * @brief Base of the format strings made by DEFERRED_PRINTF_FORMAT.
+         */
+        struct format_string
+        {
+        };
+
+        /**
+         * @brief Format plan precomputed at compile time from a format string made by DEFERRED_PRINTF_FORMAT.
+         * 
+         * @tparam Tformat The type of the format string.
+         */
+        template <typename Tformat>
+        struct format_plan
+        {
+            constexpr static char const *pcFORMAT = Tformat::value();
+            constexpr static size_t zuDIRECTIVES = count_format_directives(pcFORMAT);
+            constexpr static std::array<format_directive, zuDIRECTIVES> aDIRECTIVES = parse_format_directives<zuDIRECTIVES>(pcFORMAT);
+
+            /**
+             * @brief Counts the arguments consumed by the format string.
+             * 
+             * @return size_t The number of arguments.
+             */
+            constexpr static size_t count_args() noexcept
+            {
+                size_t zuArgs = 0;
+                for (format_directive const &directive : aDIRECTIVES)
+                {
+                    zuArgs += directive.spec.bWidthArg + directive.spec.bPrecisionArg + (directive.spec.cConversion != 0 && directive.spec.cConversion != '%');
+                }
+                return zuArgs;
+            }
+
+            constexpr static size_t zuARGS = count_args();
+
+            /**
+             * @brief Returns the ID of the format string, interning it on first use.
+             * 
+             * @return uint32_t The ID of the format string.
+             */
+            static uint32_t id() noexcept
+            {
+                static uint32_t const s_u32Id = intern_format(pcFORMAT);
+                return s_u32Id;
+            }
+
+            /**
+             * @brief Checks the argument at the given index against the conversion that consumes it.
+             * 
+             * @tparam Targ The type of the argument.
+             * @param zuIndex The index of the argument.
+             * @return true if the argument matches, false otherwise.
+             */
+            template <typename Targ>
+            constexpr static bool matches_arg(size_t zuIndex) noexcept
+            {
+                for (format_directive const &directive : aDIRECTIVES)
+                {
+                    for (bool bStar : { directive.spec.bWidthArg, directive.spec.bPrecisionArg })
+                    {
+                        if (bStar && zuIndex-- == 0)
+                        {
+                            return format_arg_matches<Targ>(directive.spec, true);
+                        }
+                    }
+                    if (directive.spec.cConversion != 0 && directive.spec.cConversion != '%' && zuIndex-- == 0)
+                    {
+                        return format_arg_matches<Targ>(directive.spec, false);
+                    }
+                }
+                return false;
+            }
+
+            /**
+             * @brief Checks the arguments against the format string.
+             * 
+             * @tparam Targs The types of the arguments.
+             * @return true if every argument matches its conversion, false otherwise.
+             */
+            template <typename... Targs, size_t... zuINDEX>
+            constexpr static bool matches(std::index_sequence<zuINDEX...>) noexcept
+            {
+                return (matches_arg<Targs>(zuINDEX) && ...);
+            }
+        };
+
+        /**
+         * @brief Formats the provided arguments by a precomputed format plan, without parsing the format string.
+         * 
+         * @param pcOutput The output buffer, which is always null-terminated unless zuSize is 0.
+         * @param zuSize The size of the output buffer.
+         * @param pcFormat The format string.
+         * @param pDirectives The directives of the format string.
+         * @param zuDirectives The number of directives.
+         * @param pArgs The arguments.
+         * @param zuArgs The number of arguments.
+         * @return int The number of characters that would have been written if the output buffer were large enough, excluding the null terminator.
+         */
+        int format_planned_args(char *pcOutput, size_t zuSize, char const *pcFormat, format_directive const *pDirectives, size_t zuDirectives, format_arg const *pArgs, size_t zuArgs) noexcept;
+
+        struct deferred_printf_log_header;
+
+        /**
+         * @brief Describes where and as what a token is stored in a log entry, so that log entries can be decoded outside the process.
+         */
+        struct deferred_printf_token_desc
+        {
+            format_arg::type eType;
+            uint8_t u8Size;
+            uint16_t u16Offset; // the offset of the token from the beginning of the log entry
+        };
+
+        /**
+         * @brief Replay thunks of one type of log entry; log entries refer to it by its index in the thunk table.
+         */
+        struct deferred_printf_thunk
+        {
+            /**
+             * @brief Applies the provided vprintf-like function to the log entry.
+             */
+            int (*pfnApply)(deferred_printf_log_header const &header, vprintf_ref fnVprintf);
+
+            /**
+             * @brief Formats the log entry into the provided output buffer with the native formatter.
+             */
+            int (*pfnFormat)(deferred_printf_log_header const &header, char *pcOutput, size_t zuSize);
+
+            /**
+             * @brief Destroys the log entry.
+             */
+            void (*pfnDestroy)(deferred_printf_log_header &header);
+
+            char const *pcFormat; // the format string, or nullptr if it is the first token of each log entry
+            uint32_t u32Tokens;
+            deferred_printf_token_desc const *pTokens;
+
+            /**
+             * @brief Returns the ID of the interned format string, or nullptr if the format string is the first token of each log entry.
+             */
+            uint32_t (*pfnFormatId)() noexcept;
+        };
+
+        /**
+         * @brief Registers a thunk in the process-wide thunk table.
+         * 
+         * @param thunk The thunk, which must have static storage duration.
+         * @return uint32_t The index of the thunk.
+         */
+        uint32_t register_thunk(deferred_printf_thunk const &thunk) noexcept;
+
+        /**
+         * @brief Returns a registered thunk.
+         * 
+         * @param u32Index The index returned by register_thunk().
+         * @return deferred_printf_thunk const & The thunk.
+         */
+        deferred_printf_thunk const &thunk_at(uint32_t u32Index) noexcept;
+
+        /**
+         * @brief Compact header of every log entry, which replaces a vtable pointer with a 32-bit thunk index.
+         * @details The tag holds the size of the log entry in its low 16 bits and flags in its high 16 bits. It is stored last, so a tag of zero means
+         *          that the log entry is still under construction, which lets concurrent readers stop there. The thunk index selects how to replay the log entry.
+         */
+        struct deferred_printf_log_header
+        {
+            constexpr static uint32_t u32SIZE_MASK = 0xFFFF;
+            constexpr static uint32_t u32TERMINAL = ~uint32_t(0); // marks a concurrent claim that did not fit; nothing follows it
+            constexpr static uint32_t u32TIMESTAMPED = 0x10000; // flag: the last 8 bytes of the log entry hold its timestamp
+            constexpr static uint32_t u32SEVERITY_SHIFT = 17; // bits 17-19 hold the severity plus one, or zero if the log entry has none
+            constexpr static uint32_t u32SEVERITY_MASK = 0x7 << u32SEVERITY_SHIFT;
+
+            /**
+             * @brief Returns the tag flags that record the provided severity.
+             * 
+             * @param eSeverity The severity.
+             * @return uint32_t The flags.
+             */
+            constexpr static uint32_t severity_flags(severity eSeverity) noexcept
+            {
+                return (static_cast<uint32_t>(eSeverity) + 1) << u32SEVERITY_SHIFT;
+            }
+
+            std::atomic<uint32_t> u32Tag;
+            uint32_t const u32Thunk;
+
+            /**
+             * @brief Constructor that records the thunk index; the tag is left for publish().
+             * 
+             * @param u32ThunkIndex The thunk index.
+             */
+            explicit deferred_printf_log_header(uint32_t u32ThunkIndex) noexcept
+                : u32Thunk(u32ThunkIndex)
+            {}
+
+            /**
+             * @brief Publishes the log entry by storing its tag.
+             * 
+             * @param zuSize The size of the log entry.
+             * @param u32Flags The flags of the log entry, e.g. u32TIMESTAMPED.
+             * @param order The memory order; release in concurrent loggers.
+             */
+            void publish(size_t zuSize, uint32_t u32Flags, std::memory_order order) noexcept
+            {
+                u32Tag.store(static_cast<uint32_t>(zuSize) | u32Flags, order);
+            }
+
+            /**
+             * @brief Returns the size of the log entry.
+             * 
+             * @return size_t The size of the log entry.
+             */
+            size_t size() const noexcept
+            {
+                return u32Tag.load(std::memory_order_relaxed) & u32SIZE_MASK;
+            }
+
+            /**
+             * @brief Reads the timestamp of the log entry, which a logger with a clock policy records.
+             * 
+             * @param u64Timestamp The timestamp, in the ticks of the clock policy.
+             * @return true if the log entry has a timestamp, false otherwise.
+             */
+            bool timestamp(uint64_t &u64Timestamp) const noexcept
+            {
+                uint32_t const u32TagValue = u32Tag.load(std::memory_order_relaxed);
+                if ((u32TagValue & u32TIMESTAMPED) == 0)
+                {
+                    return false;
+                }
+                std::memcpy(&u64Timestamp, reinterpret_cast<char const *>(this) + (u32TagValue & u32SIZE_MASK) - sizeof(u64Timestamp), sizeof(u64Timestamp));
+                return true;
+            }
+
+            /**
+             * @brief Reads the severity of the log entry, which the severity-tagged entry points record.
+             * 
+             * @param eSeverity The severity.
+             * @return true if the log entry has a severity, false otherwise.
+             */
+            bool level(severity &eSeverity) const noexcept
+            {
+                uint32_t const u32Level = (u32Tag.load(std::memory_order_relaxed) & u32SEVERITY_MASK) >> u32SEVERITY_SHIFT;
+                if (u32Level == 0)
+                {
+                    return false;
+                }
+                eSeverity = static_cast<severity>(u32Level - 1);
+                return true;
+            }
+
+            /**
+             * @brief Applies the provided vprintf-like function to the log entry.
+             * 
+             * @param fnVprintf The vprintf-like function.
+             * @return int The result of the vprintf-like function.
+             */
+            int apply(vprintf_ref fnVprintf) const
+            {
+                return thunk_at(u32Thunk).pfnApply(*this, fnVprintf);
+            }
+
+            /**
+             * @brief Formats the log entry into the provided output buffer with the native formatter.
+             * 
+             * @param pcOutput The output buffer.
+             * @param zuSize The size of the output buffer.
+             * @return int The length of the formatted log entry, as snprintf would return it.
+             */
+            int format(char *pcOutput, size_t zuSize) const noexcept
+            {
+                return thunk_at(u32Thunk).pfnFormat(*this, pcOutput, zuSize);
+            }
+
+            /**
+             * @brief Returns the format string of the log entry.
+             * 
+             * @return char const * The format string, which is the first token of the log entry unless it was made by DEFERRED_PRINTF_FORMAT.
+             */
+            char const *format_string() const noexcept
+            {
+                deferred_printf_thunk const &thunk = thunk_at(u32Thunk);
+                if (thunk.pcFormat)
+                {
+                    return thunk.pcFormat;
+                }
+                char const *pcFormat;
+                std::memcpy(&pcFormat, reinterpret_cast<char const *>(this) + thunk.pTokens[0].u16Offset, sizeof(pcFormat));
+                return pcFormat;
+            }
+
+            /**
+             * @brief Returns the ID of the format string of the log entry.
+             * @details The ID of a format string made by DEFERRED_PRINTF_FORMAT was interned at its call site; any other format string is
+             *          interned here as a copy, since it may be freed once the log entry is gone. The first query for it takes a lock; later
+             *          ones on the same thread hit a per-thread cache.
+             * 
+             * @return uint32_t The ID of the format string.
+             * @throws std::bad_alloc If the copy of a format string interned for the first time cannot be allocated.
+             */
+            uint32_t format_id() const
+            {
+                deferred_printf_thunk const &thunk = thunk_at(u32Thunk);
+                if (thunk.pfnFormatId)
+                {
+                    return thunk.pfnFormatId();
+                }
+                return intern_format_copy(format_string());
+            }
+
+            /**
+             * @brief Destroys the log entry.
+             */
+            void destroy() noexcept
+            {
+                thunk_at(u32Thunk).pfnDestroy(*this);
+            }
+        };
+
+        /**
+         * @brief Computes where each token of a log entry is packed.
+         * @details Tokens are laid out without padding, in descending order of alignment, so that they stay naturally aligned relative to each other.
+         * 
+         * @tparam Ttokens The types of the tokens.
+         * @return std::array<size_t, sizeof...(Ttokens)> The offset of each token, in the original order of the tokens.
+         */
+        template <typename... Ttokens>
+        constexpr std::array<size_t, sizeof...(Ttokens)> packed_offsets() noexcept
+        {
+            constexpr size_t azuALIGN[] = { alignof(Ttokens)..., 0 };
+            constexpr size_t azuSIZE[] = { sizeof(Ttokens)..., 0 };
+
+            std::array<size_t, sizeof...(Ttokens)> azuOffset{};
+            for (size_t i = 0; i < sizeof...(Ttokens); ++i)
+            {
+                for (size_t j = 0; j < sizeof...(Ttokens); ++j)
+                {
+                    if (azuALIGN[j] > azuALIGN[i] || (azuALIGN[j] == azuALIGN[i] && j < i))
+                    {
+                        azuOffset[i] += azuSIZE[j];
+                    }
+                }
+            }
+            return azuOffset;
+        }
+
+        /**
+         * @brief Packed storage of the tokens of a log entry.
+         * @details The tokens are packed without padding and loaded with memcpy on replay, in their original order.
+         * 
+         * @tparam Ttokens The types of the tokens.
+         */
+        template <typename... Ttokens>
+        class deferred_printf_tokens
+        {
+            static_assert((std::is_trivially_copyable_v<Ttokens> && ...), "Ttokens must be trivially copyable");
+
+            constexpr static std::array<size_t, sizeof...(Ttokens)> azuOFFSET = packed_offsets<Ttokens...>();
+
+            char m_acToken[(sizeof(Ttokens) + ... + 0) + (sizeof...(Ttokens) == 0)]; // no zero-sized array when there are no tokens
+        public:
+            /**
+             * @brief Describes the tokens.
+             * 
+             * @param zuBase The offset of the packed storage from the beginning of the log entry.
+             * @return std::array<deferred_printf_token_desc, sizeof...(Ttokens)> The descriptions of the tokens, in their original order.
+             */
+            constexpr static std::array<deferred_printf_token_desc, sizeof...(Ttokens)> describe(size_t zuBase) noexcept
+            {
+                std::array<deferred_printf_token_desc, sizeof...(Ttokens)> aTokens{};
+                format_arg::type const aeTYPE[] = { format_arg_type<Ttokens>()..., format_arg::type::sint };
+                uint8_t const au8SIZE[] = { static_cast<uint8_t>(sizeof(Ttokens))..., 0 };
+                for (size_t i = 0; i < sizeof...(Ttokens); ++i)
+                {
+                    aTokens[i] = { aeTYPE[i], au8SIZE[i], static_cast<uint16_t>(zuBase + azuOFFSET[i]) };
+                }
+                return aTokens;
+            }
+
+            /**
+             * @brief Constructor that packs the tokens of the provided arguments, copying copied_string arguments after the log entry.
+             * 
+             * @tparam Targs The types of the arguments, whose tokens are of the types Ttokens.
+             * @param pcEntry The log entry.
+             * @param zuInline The offset at which the first copied string is copied, i.e. the size of the fixed part of the log entry.
+             * @param tArgs The arguments.
+             */
+            template <typename... Targs>
+            deferred_printf_tokens(char *pcEntry, size_t zuInline, Targs const &... tArgs) noexcept
+            {
+                static_assert((std::is_same_v<stored_t<Targs>, Ttokens> && ...), "Each argument must be stored as its token");
+
+                [[maybe_unused]] auto const pack = [&](auto const &tArg, size_t zuOffset)
+                {
+                    auto const tToken = store_token(tArg, pcEntry, zuInline);
+                    std::memcpy(m_acToken + zuOffset, &tToken, sizeof(tToken));
+                };
+                size_t zuIndex = 0;
+                (pack(tArgs, azuOFFSET[zuIndex++]), ...);
+            }
+
+            /**
+             * @brief Loads a token from the packed storage.
+             * 
+             * @tparam zuINDEX The index of the token.
+             * @return The token.
+             */
+            template <size_t zuINDEX>
+            std::tuple_element_t<zuINDEX, std::tuple<Ttokens...>> load() const noexcept
+            {
+                std::tuple_element_t<zuINDEX, std::tuple<Ttokens...>> tToken;
+                std::memcpy(&tToken, m_acToken + azuOFFSET[zuINDEX], sizeof(tToken));
+                return tToken;
+            }
+        };
+
+        /**
+         * @brief Template class for deferred log entries.
+         * 
+         * @tparam Ttokens The types of the tokens, the first of which is the format string.
+         */
+        template <typename... Ttokens>
+        class Cdeferred_printf_log : public deferred_printf_log_header
+        {
+            deferred_printf_tokens<Ttokens...> m_Tokens;
+
+            constexpr static std::array<deferred_printf_token_desc, sizeof...(Ttokens)> aTOKENS = deferred_printf_tokens<Ttokens...>::describe(sizeof(deferred_printf_log_header));
+
+            /**
+             * @brief Calls the vprintf-like function with the tokens in their original order.
+             * 
+             * @param fnVprintf The vprintf-like function.
+             * @return int The result of the vprintf-like function.
+             */
+            template <size_t... zuINDEX>
+            int apply(vprintf_ref fnVprintf, std::index_sequence<zuINDEX...>) const
+            {
+                return vprintf_wrapper<vprintf_ref>{ fnVprintf }(resolve_token(reinterpret_cast<char const *>(this), m_Tokens.template load<zuINDEX>())...);
+            }
+
+            /**
+             * @brief Applies the provided vprintf-like function to the log entry.
+             * 
+             * @param header The header of the log entry.
+             * @param fnVprintf The vprintf-like function.
+             * @return int The result of the vprintf-like function.
+             */
+            static int apply(deferred_printf_log_header const &header, vprintf_ref fnVprintf)
+            {
+                return static_cast<Cdeferred_printf_log const &>(header).apply(fnVprintf, std::index_sequence_for<Ttokens...>());
+            }
+
+            /**
+             * @brief Formats the tokens after the format string with the native formatter.
+             * 
+             * @param pcOutput The output buffer.
+             * @param zuSize The size of the output buffer.
+             * @return int The length of the formatted log entry.
+             */
+            template <size_t... zuINDEX>
+            int format(char *pcOutput, size_t zuSize, std::index_sequence<zuINDEX...>) const noexcept
+            {
+                format_arg const aArgs[sizeof...(zuINDEX) + 1] = { make_format_arg(resolve_token(reinterpret_cast<char const *>(this), m_Tokens.template load<zuINDEX + 1>()))... };
+                return format_args(pcOutput, zuSize, m_Tokens.template load<0>(), aArgs, sizeof...(zuINDEX));
+            }
+
+            /**
+             * @brief Formats the log entry with the native formatter.
+             * 
+             * @param header The header of the log entry.
+             * @param pcOutput The output buffer.
+             * @param zuSize The size of the output buffer.
+             * @return int The length of the formatted log entry.
+             */
+            static int format(deferred_printf_log_header const &header, char *pcOutput, size_t zuSize) noexcept
+            {
+                return static_cast<Cdeferred_printf_log const &>(header).format(pcOutput, zuSize, std::make_index_sequence<sizeof...(Ttokens) - 1>());
+            }
+
+            /**
+             * @brief Destroys the log entry.
+             * 
+             * @param header The header of the log entry.
+             */
+            static void destroy(deferred_printf_log_header &header) noexcept
+            {
+                static_cast<Cdeferred_printf_log &>(header).~Cdeferred_printf_log();
+            }
+        public:
+            constexpr static deferred_printf_thunk thunk = { &apply, &format, &destroy, nullptr, sizeof...(Ttokens), aTOKENS.data(), nullptr };
+
+            /**
+             * @brief Returns the index of the thunk of this type of log entry, registering it on first use.
+             * 
+             * @return uint32_t The thunk index.
+             */
+            static uint32_t thunk_index() noexcept
+            {
+                static uint32_t const s_u32Index = register_thunk(thunk);
+                return s_u32Index;
+            }
+
+            /**
+             * @brief Constructor that packs the provided arguments into the log entry.
+             * 
+             * @tparam Targs The types of the arguments, whose tokens are of the types Ttokens.
+             * @param tArgs The arguments; copied_string arguments are copied right after the log entry.
+             */
+            template <typename... Targs>
+            Cdeferred_printf_log(Targs const &... tArgs) noexcept
+                : deferred_printf_log_header(thunk_index())
+                , m_Tokens(reinterpret_cast<char *>(this), sizeof(Cdeferred_printf_log), tArgs...)
+            {}
+        };
+
+        /**
+         * @brief Template class for deferred log entries whose format string was parsed at compile time.
+         * @details The format string is part of the type, so it takes no space in the log entry, and the native formatter replays the precomputed format plan.
+         * 
+         * @tparam Tformat The type of the format string, made by DEFERRED_PRINTF_FORMAT.
+         * @tparam Targs The types of the arguments.
+         */
+        template <typename Tformat, typename... Targs>
+        class Cdeferred_printf_planned_log : public deferred_printf_log_header
+        {
+            using plan_t = format_plan<Tformat>;
+
+            deferred_printf_tokens<Targs...> m_Tokens;
+
+            constexpr static std::array<deferred_printf_token_desc, sizeof...(Targs)> aTOKENS = deferred_printf_tokens<Targs...>::describe(sizeof(deferred_printf_log_header));
+
+            /**
+             * @brief Calls the vprintf-like function with the format string and the arguments.
+             * 
+             * @param fnVprintf The vprintf-like function.
+             * @return int The result of the vprintf-like function.
+             */
+            template <size_t... zuINDEX>
+            int apply(vprintf_ref fnVprintf, std::index_sequence<zuINDEX...>) const
+            {
+                return vprintf_wrapper<vprintf_ref>{ fnVprintf }(plan_t::pcFORMAT, resolve_token(reinterpret_cast<char const *>(this), m_Tokens.template load<zuINDEX>())...);
+            }
+
+            /**
+             * @brief Applies the provided vprintf-like function to the log entry.
+             * 
+             * @param header The header of the log entry.
+             * @param fnVprintf The vprintf-like function.
+             * @return int The result of the vprintf-like function.
+             */
+            static int apply(deferred_printf_log_header const &header, vprintf_ref fnVprintf)
+            {
+                return static_cast<Cdeferred_printf_planned_log const &>(header).apply(fnVprintf, std::index_sequence_for<Targs...>());
+            }
+
+            /**
+             * @brief Formats the arguments by the format plan.
+             * 
+             * @param pcOutput The output buffer.
+             * @param zuSize The size of the output buffer.
+             * @return int The length of the formatted log entry.
+             */
+            template <size_t... zuINDEX>
+            int format(char *pcOutput, size_t zuSize, std::index_sequence<zuINDEX...>) const noexcept
+            {
+                format_arg const aArgs[sizeof...(zuINDEX) + 1] = { make_format_arg(resolve_token(reinterpret_cast<char const *>(this), m_Tokens.template load<zuINDEX>()))... };
+                return format_planned_args(pcOutput, zuSize, plan_t::pcFORMAT, plan_t::aDIRECTIVES.data(), plan_t::zuDIRECTIVES, aArgs, sizeof...(zuINDEX));
+            }
+
+            /**
+             * @brief Formats the log entry by the format plan.
+             * 
+             * @param header The header of the log entry.
+             * @param pcOutput The output buffer.
+             * @param zuSize The size of the output buffer.
+             * @return int The length of the formatted log entry.
+             */
+            static int format(deferred_printf_log_header const &header, char *pcOutput, size_t zuSize) noexcept
+            {
+                return static_cast<Cdeferred_printf_planned_log const &>(header).format(pcOutput, zuSize, std::index_sequence_for<Targs...>());
+            }
+
+            /**
+             * @brief Destroys the log entry.
+             * 
+             * @param header The header of the log entry.
+             */
+            static void destroy(deferred_printf_log_header &header) noexcept
+            {
+                static_cast<Cdeferred_printf_planned_log &>(header).~Cdeferred_printf_planned_log();
+            }
+        public:
+            static_assert(sizeof...(Targs) == plan_t::zuARGS, "The number of arguments does not match the format string");
+            static_assert(plan_t::template matches<Targs...>(std::index_sequence_for<Targs...>()), "An argument does not match its conversion in the format string");
+
+            constexpr static deferred_printf_thunk thunk = { &apply, &format, &destroy, plan_t::pcFORMAT, sizeof...(Targs), aTOKENS.data(), &plan_t::id };
+
+            /**
+             * @brief Returns the index of the thunk of this type of log entry, registering it and interning its format string on first use.
+             * 
+             * @return uint32_t The thunk index.
+             */
+            static uint32_t thunk_index() noexcept
+            {
+                static uint32_t const s_u32Index = (plan_t::id(), register_thunk(thunk));
+                return s_u32Index;
+            }
+
+            /**
+             * @brief Constructor that packs the provided arguments into the log entry.
+             * 
+             * @tparam Tvalues The types of the arguments, whose tokens are of the types Targs.
+             * @param tValues The arguments; copied_string arguments are copied right after the log entry.
+             */
+            template <typename... Tvalues>
+            Cdeferred_printf_planned_log(Tvalues const &... tValues) noexcept
+                : deferred_printf_log_header(thunk_index())
+                , m_Tokens(reinterpret_cast<char *>(this), sizeof(Cdeferred_printf_planned_log), tValues...)
+            {}
+        };
+
+        /**
+         * @brief Iterator class for iterating over deferred log entries.
+         * 
+         * @tparam Tchar The character type of the buffer.
+         */
+        template <typename Tchar>
+        class deferred_printf_log_iterator
+        {
+            Tchar *m_pBuffer;
+            Tchar *m_pWrap;
+            Tchar *m_pBase;
+            deferred_printf_chunk const *m_pChunk;
+
+            /**
+             * @brief Moves past the end of the current segment of log entries while the iterator is there.
+             */
+            void follow() noexcept;
+        public:
+            using reference = std::conditional_t<std::is_const_v<Tchar>, deferred_printf_log_header const &, deferred_printf_log_header &>;
+
+            /**
+             * @brief Constructor that initializes the iterator with the provided buffer.
+             * 
+             * @param pcBuffer The buffer.
+             */
+            deferred_printf_log_iterator(Tchar *pcBuffer) noexcept;
+
+            /**
+             * @brief Constructor that initializes the iterator with the provided buffer and a wrap point.
+             * 
+             * @param pcBuffer The buffer.
+             * @param pcWrap The position at which the iterator continues with pChunk, or from pcBase if there is no chunk; nullptr if there is no wrap point.
+             * @param pcBase The beginning of the ring buffer.
+             * @param pChunk The chunk that continues the buffer, or nullptr.
+             */
+            deferred_printf_log_iterator(Tchar *pcBuffer, Tchar *pcWrap, Tchar *pcBase, deferred_printf_chunk const *pChunk) noexcept;
+
+            /**
+             * @brief Inequality operator.
+             * 
+             * @param other The other iterator.
+             * @return bool True if the iterators are not equal, false otherwise.
+             */
+            bool operator!=(const deferred_printf_log_iterator<Tchar> &other) const noexcept;
+
+            /**
+             * @brief Pre-increment operator.
+             * 
+             * @return deferred_printf_log_iterator& The incremented iterator.
+             */
+            deferred_printf_log_iterator<Tchar> &operator++() noexcept;
+
+            /**
+             * @brief Dereference operator.
+             * 
+             * @return deferred_printf_log_header& The log entry.
+             */
+            reference operator*() const noexcept;
+        };
+
+        /**
+         * @brief Allocator adaptor that default-initializes instead of value-initializing, so that resizing a buffer does not zero it.
+         * 
+         * @tparam Tallocator The adapted allocator.
+         */
+        template <typename Tallocator>
+        struct default_init_allocator : Tallocator
+        {
+            using Tallocator::Tallocator;
+
+            default_init_allocator(Tallocator const &allocator) noexcept
+                : Tallocator(allocator)
+            {}
+
+            template <typename T>
+            struct rebind
+            {
+                using other = default_init_allocator<typename std::allocator_traits<Tallocator>::template rebind_alloc<T>>;
+            };
+
+            /**
+             * @brief Default-initializes an object, which leaves a char uninitialized.
+             * 
+             * @tparam T The type of the object.
+             * @param p The storage of the object.
+             */
+            template <typename T>
+            void construct(T *p) noexcept(std::is_nothrow_default_constructible_v<T>)
+            {
+                ::new (static_cast<void *>(p)) T;
+            }
+
+            /**
+             * @brief Constructs an object with the adapted allocator.
+             * 
+             * @tparam T The type of the object.
+             * @tparam Targs The types of the arguments of its constructor.
+             * @param p The storage of the object.
+             * @param tArgs The arguments of its constructor.
+             */
+            template <typename T, typename... Targs>
+            void construct(T *p, Targs &&... tArgs)
+            {
+                std::allocator_traits<Tallocator>::construct(static_cast<Tallocator &>(*this), p, std::forward<Targs>(tArgs)...);
+            }
+        };
+
+        /**
+         * @brief Inline buffer of a logger, which ignores the allocator and leaves its bytes uninitialized.
+         * 
+         * @tparam zuSIZE The size of the buffer.
+         */
+        template <size_t zuSIZE>
+        struct inline_buffer : std::array<char, zuSIZE>
+        {
+            template <typename Tallocator>
+            explicit inline_buffer(Tallocator const &) noexcept
+            {}
+        };
+
+        /**
+         * @brief Template class for logging deferred log entries.
+         * 
+         * @tparam zuCAPACITY The capacity of the logger.
+         * @tparam bCONCURRENT Whether multiple threads may log into the logger at the same time.
+         * @tparam Toverflow The overflow policy: overflow_throw, overflow_overwrite, overflow_drop, overflow_block, overflow_grow or overflow_flush.
+         * @tparam Tclock The clock policy: clock_none, clock_tsc or clock_monotonic.
+         * @tparam Tallocator The allocator of a buffer on the heap, i.e. for a capacity above 4000, e.g. std::pmr::polymorphic_allocator<char>.
+         * @details In concurrent mode, each thread claims its space with a single atomic fetch-add and constructs its log entry in place.
+         *          The tag of each log entry is published after construction, so that iteration stops at the first entry still under construction.
+         */
+        template <size_t zuCAPACITY = 4000, bool bCONCURRENT = false, typename Toverflow = overflow_throw, typename Tclock = clock_none, typename Tallocator = std::allocator<char>>
+        class deferred_printf_logger
+        {
+            constexpr static bool bRING = std::is_same_v<Toverflow, overflow_overwrite>;
+            constexpr static bool bDROP = std::is_same_v<Toverflow, overflow_drop>;
+            constexpr static bool bBLOCK = std::is_same_v<Toverflow, overflow_block>;
+            constexpr static bool bGROW = std::is_same_v<Toverflow, overflow_grow>;
+            constexpr static bool bFLUSH = std::is_same_v<Toverflow, overflow_flush>;
+            constexpr static size_t zuINLINE = bGROW ? 0 : zuCAPACITY; // a segmented logger keeps all log entries in pages
+
+            constexpr static bool bHEAP = zuINLINE > 4000;
+
+            using buffer_t = std::conditional_t<bHEAP, std::vector<char, default_init_allocator<Tallocator>>, inline_buffer<zuINLINE>>;
+            using counter_t = std::conditional_t<bCONCURRENT, std::atomic<size_t>, size_t>;
+            constexpr static size_t zuNO_WRAP = ~size_t(0);
+            constexpr static size_t zuSEALED = ~size_t(0) / 2; // m_zuLength while a concurrent drain is in progress
+            constexpr static size_t zuCLOSED = zuSEALED + zuSEALED / 2; // m_zuLength after drain(..., true) until reopen()
+            constexpr static size_t zuUNALLOCATED = zuCLOSED + zuSEALED / 4; // m_zuLength of a concurrent logger left without a buffer by a move
+
+            static_assert(!(bRING && bCONCURRENT), "overflow_overwrite supports a single producer only");
+            static_assert(!(bGROW && bCONCURRENT), "overflow_grow supports a single producer only");
+            static_assert(!(bBLOCK && !bCONCURRENT), "overflow_block needs a concurrent logger, since only another thread can free space");
+            static_assert(std::is_same_v<typename std::allocator_traits<Tallocator>::value_type, char>, "Tallocator must allocate char");
+
+            counter_t m_zuLength;
+            counter_t m_zuDropped;
+            counter_t m_zuHighWater; // the most bytes logged between two drains
+            size_t m_zuLogged; // the bytes logged by a single-producer logger since the last drain, including those the ring buffer discarded
+            size_t m_zuHead; // offset of the oldest log entry; only the ring buffer ever moves it away from zero
+            size_t m_zuWrap; // offset at which the ring buffer continues from the beginning, or zuNO_WRAP
+            Toverflow m_Overflow;
+            alignas(std::max_align_t) buffer_t m_buffer;
+
+            /**
+             * @brief Returns the header of the log entry at the given offset.
+             * 
+             * @param zuOffset The offset.
+             * @return deferred_printf_log_header * The header.
+             */
+            deferred_printf_log_header *header_at(size_t zuOffset) const noexcept
+            {
+                return reinterpret_cast<deferred_printf_log_header *>(const_cast<char *>(m_buffer.data()) + zuOffset);
+            }
+
+            /**
+             * @brief Raises the high-water mark to the provided number of bytes logged since the last drain, if it is higher.
+             * 
+             * @param zuBytes The number of bytes.
+             */
+            void raise_high_water(size_t zuBytes) noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    size_t zuHighWater = m_zuHighWater.load(std::memory_order_relaxed);
+                    while (zuHighWater < zuBytes && !m_zuHighWater.compare_exchange_weak(zuHighWater, zuBytes, std::memory_order_relaxed))
+                    {
+                    }
+                }
+                else
+                {
+                    m_zuHighWater = (std::max)(m_zuHighWater, zuBytes);
+                }
+            }
+
+            /**
+             * @brief Claims space for a log entry in a concurrent logger, applying the overflow policy when it does not fit.
+             * @details While the logger is sealed, it waits instead, since the buffer is about to be emptied, not full.
+             * 
+             * @param zuSize The size of the log entry.
+             * @return char * The claimed space, or nullptr if the log entry is dropped.
+             */
+            char *claim(size_t zuSize) noexcept(Toverflow::bNOEXCEPT)
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    for (;;)
+                    {
+                        size_t const zuOffset = m_zuLength.fetch_add(zuSize, std::memory_order_acquire); // pairs with the release in drain()
+                        if (zuOffset + zuSize <= zuCAPACITY)
+                        {
+                            raise_high_water(zuOffset + zuSize);
+                            return m_buffer.data() + zuOffset;
+                        }
+                        if (zuOffset >= zuSEALED && zuOffset < zuCLOSED)
+                        {
+                            std::this_thread::yield(); // sealed by a drain in progress, which frees space rather than lacks it
+                            continue;
+                        }
+                        if constexpr (bHEAP)
+                        {
+                            if (zuOffset >= zuUNALLOCATED)
+                            {
+                                if (!allocate_lazily())
+                                {
+                                    m_zuDropped.fetch_add(1, std::memory_order_relaxed);
+                                    return nullptr;
+                                }
+                                continue; // claim again from the new buffer
+                            }
+                        }
+                        if (zuOffset + sizeof(deferred_printf_log_header) <= zuCAPACITY)
+                        {
+                            // Nothing can follow a failed claim, so tell a concurrent drain not to wait beyond it
+                            header_at(zuOffset)->u32Tag.store(deferred_printf_log_header::u32TERMINAL, std::memory_order_release);
+                        }
+
+                        if constexpr (bDROP)
+                        {
+                            m_zuDropped.fetch_add(1, std::memory_order_relaxed);
+                            return nullptr;
+                        }
+                        else if constexpr (bBLOCK)
+                        {
+                            std::this_thread::yield();
+                        }
+                        else if constexpr (bFLUSH)
+                        {
+                            drain([this](deferred_printf_log_header const &iLog) { iLog.apply(m_Overflow.fnVprintf); });
+                        }
+                        else
+                        {
+                            throw std::bad_alloc();
+                        }
+                    }
+                }
+                else
+                {
+                    return nullptr; // single-producer loggers reserve() instead
+                }
+            }
+
+            /**
+             * @brief Reserves space for a log entry in a single-producer logger, applying the overflow policy when it does not fit.
+             * 
+             * @param zuSize The size of the log entry.
+             * @return char * The reserved space, or nullptr if the log entry is dropped.
+             */
+            char *reserve(size_t zuSize) noexcept(Toverflow::bNOEXCEPT)
+            {
+                if constexpr (bHEAP && !bCONCURRENT)
+                {
+                    if (m_buffer.empty() && !allocate_lazily())
+                    {
+                        ++m_zuDropped;
+                        return nullptr;
+                    }
+                }
+
+                if constexpr (bCONCURRENT)
+                {
+                    return nullptr; // concurrent loggers claim() instead
+                }
+                else if constexpr (bRING)
+                {
+                    char *pcEntry = m_buffer.data() + reserve_ring(zuSize);
+                    m_zuLogged += zuSize;
+                    raise_high_water(m_zuLogged);
+                    return pcEntry;
+                }
+                else if constexpr (bGROW)
+                {
+                    char *pcEntry = m_Overflow.chunks.reserve(zuSize);
+                    if (pcEntry == nullptr)
+                    {
+                        ++m_zuDropped;
+                        return nullptr;
+                    }
+                    m_zuLogged += zuSize;
+                    raise_high_water(m_zuLogged);
+                    return pcEntry;
+                }
+                else
+                {
+                    for (;;)
+                    {
+                        if (m_zuLength + zuSize <= zuCAPACITY)
+                        {
+                            char *pcEntry = m_buffer.data() + m_zuLength;
+                            m_zuLength += zuSize;
+                            m_zuLogged += zuSize;
+                            raise_high_water(m_zuLogged);
+                            return pcEntry;
+                        }
+
+                        if constexpr (bDROP)
+                        {
+                            ++m_zuDropped;
+                            return nullptr;
+                        }
+                        else if constexpr (bFLUSH)
+                        {
+                            drain([this](deferred_printf_log_header const &iLog) { iLog.apply(m_Overflow.fnVprintf); });
+                        }
+                        else
+                        {
+                            throw std::bad_alloc();
+                        }
+                    }
+                }
+            }
+
+            /**
+             * @brief Reserves space for a log entry in the ring buffer, discarding the oldest log entries as necessary.
+             * 
+             * @param zuSize The size of the log entry, which must not exceed zuCAPACITY.
+             * @return size_t The offset of the reserved space.
+             */
+            size_t reserve_ring(size_t zuSize) noexcept
+            {
+                for (;;)
+                {
+                    if (m_zuHead <= m_zuLength) // not wrapped, possibly empty
+                    {
+                        if (m_zuLength + zuSize <= zuCAPACITY)
+                        {
+                            break;
+                        }
+                        if (m_zuHead == m_zuLength)
+                        {
+                            m_zuHead = m_zuLength = 0;
+                        }
+                        else if (m_zuHead == 0)
+                        {
+                            discard_oldest(); // wrapping now would make the full buffer look empty
+                        }
+                        else
+                        {
+                            m_zuWrap = m_zuLength;
+                            m_zuLength = 0;
+                        }
+                    }
+                    else if (m_zuLength + zuSize < m_zuHead) // wrapped; keep the tail strictly behind the head
+                    {
+                        break;
+                    }
+                    else
+                    {
+                        discard_oldest();
+                    }
+                }
+                size_t const zuOffset = m_zuLength;
+                m_zuLength += zuSize;
+                return zuOffset;
+            }
+
+            /**
+             * @brief Discards the oldest log entry of the ring buffer.
+             */
+            void discard_oldest() noexcept
+            {
+                deferred_printf_log_header &iLog = *header_at(m_zuHead);
+                m_zuHead += iLog.size();
+                if constexpr (!bSKIP_DESTRUCTION)
+                {
+                    iLog.destroy();
+                }
+                if (m_zuHead == m_zuWrap)
+                {
+                    m_zuHead = 0;
+                    m_zuWrap = zuNO_WRAP;
+                }
+            }
+
+            /**
+             * @brief Returns an iterator to the oldest log entry.
+             * 
+             * @tparam Tchar The character type of the iterator.
+             * @return deferred_printf_log_iterator<Tchar> The iterator.
+             */
+            template <typename Tchar>
+            deferred_printf_log_iterator<Tchar> first() const noexcept
+            {
+                Tchar *pcBuffer = const_cast<Tchar *>(m_buffer.data());
+                if constexpr (bGROW)
+                {
+                    deferred_printf_chunk const *pHead = m_Overflow.chunks.head();
+                    if (pHead == nullptr)
+                    {
+                        return { pcBuffer };
+                    }
+                    return { pHead->data(), pHead->pNext ? pHead->data() + pHead->zuLength : nullptr, nullptr, pHead->pNext };
+                }
+                else
+                {
+                    return { pcBuffer + m_zuHead, m_zuWrap == zuNO_WRAP ? nullptr : pcBuffer + m_zuWrap, pcBuffer, nullptr };
+                }
+            }
+
+            /**
+             * @brief Returns the end of the last published log entry.
+             * 
+             * @return char const * The end.
+             */
+            char const *committed_end() const noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    size_t zuLength = m_zuLength.load(std::memory_order_acquire);
+                    zuLength = zuLength >= zuCLOSED ? 0 : (std::min)(zuLength, zuCAPACITY); // a closed logger, or one without a buffer, is empty
+                    size_t zuOffset = 0;
+                    while (zuOffset + sizeof(deferred_printf_log_header) <= zuLength)
+                    {
+                        uint32_t const u32Tag = header_at(zuOffset)->u32Tag.load(std::memory_order_acquire);
+                        if (u32Tag == 0 || u32Tag == deferred_printf_log_header::u32TERMINAL)
+                        {
+                            break;
+                        }
+                        zuOffset += u32Tag & deferred_printf_log_header::u32SIZE_MASK;
+                    }
+                    return m_buffer.data() + zuOffset;
+                }
+                else if constexpr (bGROW)
+                {
+                    deferred_printf_chunk const *pTail = m_Overflow.chunks.tail();
+                    return pTail ? pTail->data() + pTail->zuLength : m_buffer.data();
+                }
+                else
+                {
+                    return m_buffer.data() + m_zuLength;
+                }
+            }
+
+            /**
+             * @brief Waits until every space claimed in a concurrent logger is either published or known to be unused.
+             * 
+             * @param zuClaimed The value of m_zuLength when the logger was sealed.
+             */
+            void wait_for_claims(size_t zuClaimed) const noexcept
+            {
+                size_t const zuLength = (std::min)(zuClaimed, zuCAPACITY);
+                size_t zuOffset = 0;
+                while (zuOffset + sizeof(deferred_printf_log_header) <= zuLength)
+                {
+                    uint32_t u32Tag;
+                    while ((u32Tag = header_at(zuOffset)->u32Tag.load(std::memory_order_acquire)) == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                    if (u32Tag == deferred_printf_log_header::u32TERMINAL)
+                    {
+                        break;
+                    }
+                    zuOffset += u32Tag & deferred_printf_log_header::u32SIZE_MASK;
+                }
+            }
+
+            /**
+             * @brief Destroys all log entries if destruction is not skipped, without releasing their space.
+             */
+            void clear_entries() noexcept
+            {
+                if constexpr (!bSKIP_DESTRUCTION)
+                {
+                    for (deferred_printf_log_header & iLog : *this)
+                    {
+                        iLog.destroy();
+                    }
+                }
+            }
+
+            /**
+             * @brief Returns the end of the bytes in use, including a ring buffer wrapped around.
+             * 
+             * @return size_t The offset.
+             */
+            size_t extent() const noexcept
+            {
+                size_t zuLength;
+                if constexpr (bCONCURRENT)
+                {
+                    zuLength = m_zuLength.load(std::memory_order_relaxed);
+                    zuLength = zuLength >= zuCLOSED ? 0 : (std::min)(zuLength, zuCAPACITY); // failed claims overshoot
+                }
+                else
+                {
+                    zuLength = m_zuLength;
+                }
+                return m_zuWrap == zuNO_WRAP ? zuLength : (std::max)(m_zuWrap, zuLength);
+            }
+
+            /**
+             * @brief Exchanges two counters; the loggers are not in use by other threads.
+             * 
+             * @param a The first counter.
+             * @param b The second counter.
+             */
+            static void swap_counters(counter_t &a, counter_t &b) noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    size_t const zu = a.load(std::memory_order_relaxed);
+                    a.store(b.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    b.store(zu, std::memory_order_relaxed);
+                }
+                else
+                {
+                    std::swap(a, b);
+                }
+            }
+
+            /**
+             * @brief Returns an overflow policy like the provided one, for a new empty logger.
+             * 
+             * @param overflow The overflow policy.
+             * @return Toverflow The overflow policy; an overflow_grow takes pages from the same pool.
+             */
+            static Toverflow fresh_overflow(Toverflow const &overflow)
+            {
+                if constexpr (bGROW)
+                {
+                    return overflow_grow(*overflow.chunks.pool());
+                }
+                else
+                {
+                    return overflow;
+                }
+            }
+
+            /**
+             * @brief Allocates the buffer on the heap, zeroing it if the logger is concurrent.
+             */
+            void allocate_buffer()
+            {
+                if constexpr (bHEAP)
+                {
+                    m_buffer.resize(zuINLINE); // default-initialized, so no page is touched here
+                    if constexpr (bCONCURRENT)
+                    {
+                        std::memset(m_buffer.data(), 0, zuINLINE); // tags must read zero until published
+                    }
+                }
+            }
+
+            /**
+             * @brief Allocates the buffer on the heap of a logger left without one by the move constructor, on its first log entry.
+             * @details In concurrent mode, one producer seals the logger while it allocates, so the others wait as they do during a drain;
+             *          a producer that finds the buffer already allocated returns at once.
+             * 
+             * @return bool True if the buffer is allocated, false if the allocation failed under a policy that does not throw.
+             */
+            bool allocate_lazily() noexcept(Toverflow::bNOEXCEPT)
+            {
+                if constexpr (bHEAP)
+                {
+                    if constexpr (bCONCURRENT)
+                    {
+                        size_t zuState = m_zuLength.load(std::memory_order_relaxed);
+                        do
+                        {
+                            if (zuState < zuUNALLOCATED)
+                            {
+                                return true; // another producer allocated it
+                            }
+                        }
+                        while (!m_zuLength.compare_exchange_weak(zuState, zuSEALED, std::memory_order_acq_rel, std::memory_order_relaxed));
+                    }
+                    try
+                    {
+                        allocate_buffer();
+                    }
+                    catch (std::bad_alloc const &)
+                    {
+                        if constexpr (bCONCURRENT)
+                        {
+                            m_zuLength.store(zuUNALLOCATED, std::memory_order_release);
+                        }
+                        if constexpr (!Toverflow::bNOEXCEPT)
+                        {
+                            throw;
+                        }
+                        return false;
+                    }
+                    if constexpr (bCONCURRENT)
+                    {
+                        m_zuLength.store(0, std::memory_order_release); // pairs with the acquire in claim()
+                    }
+                }
+                return true;
+            }
+
+            /**
+             * @brief Allocates the buffer on the heap of a logger left without one by the move constructor; no other thread may use it.
+             * @throws std::bad_alloc If the buffer cannot be allocated.
+             */
+            void ensure_buffer()
+            {
+                if (bHEAP && m_buffer.empty())
+                {
+                    allocate_buffer();
+                    if constexpr (bCONCURRENT)
+                    {
+                        if (m_zuLength.load(std::memory_order_relaxed) >= zuUNALLOCATED)
+                        {
+                            m_zuLength.store(0, std::memory_order_relaxed); // a closed logger stays closed
+                        }
+                    }
+                }
+            }
+
+            /**
+             * @brief Tag that selects the constructor that leaves a buffer on the heap unallocated.
+             */
+            struct unallocated_t {};
+
+            /**
+             * @brief Constructs a new deferred printf logger object without a buffer on the heap, which is allocated on its first log entry.
+             * @details An inline buffer is part of the object, and is zeroed if the logger is concurrent.
+             * 
+             * @param overflow The overflow policy.
+             * @param allocator The allocator of a buffer on the heap; an inline buffer ignores it.
+             */
+            deferred_printf_logger(Toverflow overflow, Tallocator const &allocator, unallocated_t) noexcept(std::is_nothrow_move_constructible_v<Toverflow>)
+                : m_zuLength(bHEAP && bCONCURRENT ? zuUNALLOCATED : 0)
+                , m_zuDropped(0)
+                , m_zuHighWater(0)
+                , m_zuLogged(0)
+                , m_zuHead(0)
+                , m_zuWrap(zuNO_WRAP)
+                , m_Overflow(std::move(overflow))
+                , m_buffer(allocator)
+            {
+                if constexpr (bGROW)
+                {
+                    if (m_Overflow.chunks.pool() == nullptr)
+                    {
+                        m_Overflow.chunks.set_pool(&deferred_printf_page_pool::shared<zuCAPACITY>());
+                    }
+                }
+                if constexpr (bCONCURRENT && !bHEAP)
+                {
+                    std::memset(m_buffer.data(), 0, zuINLINE); // tags must read zero until published
+                }
+            }
+        public:
+            using iterator = deferred_printf_log_iterator<char>;
+            using const_iterator = deferred_printf_log_iterator<char const>;
+
+            /**
+             * @brief Constructs a new deferred printf logger object.
+             */
+            deferred_printf_logger()
+                : deferred_printf_logger(Toverflow())
+            {
+            }
+
+            /**
+             * @brief Constructs a new deferred printf logger object with the provided overflow policy.
+             * 
+             * @param overflow The overflow policy, e.g. an overflow_flush with its vprintf-like function.
+             */
+            explicit deferred_printf_logger(Toverflow overflow)
+                : deferred_printf_logger(std::move(overflow), Tallocator())
+            {
+            }
+
+            /**
+             * @brief Constructs a new deferred printf logger object with the provided overflow policy and allocator.
+             * @details A buffer on the heap is left uninitialized, unless the logger is concurrent, which needs it zeroed.
+             * 
+             * @param overflow The overflow policy.
+             * @param allocator The allocator of a buffer on the heap; an inline buffer ignores it.
+             */
+            deferred_printf_logger(Toverflow overflow, Tallocator const &allocator)
+                : deferred_printf_logger(std::move(overflow), allocator, unallocated_t())
+            {
+                if constexpr (bHEAP)
+                {
+                    allocate_buffer();
+                    if constexpr (bCONCURRENT)
+                    {
+                        m_zuLength.store(0, std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /**
+             * @brief Controls whether to skip destruction of log entries.
+             */
+            constexpr static bool bSKIP_DESTRUCTION = true;
+
+            /**
+             * @brief Whether swap() never throws, i.e. unless buffers on the heap may come from unequal allocators that do not propagate,
+             *        in which case a buffer left unallocated by a move is allocated before the log entries are exchanged.
+             */
+            constexpr static bool bNOTHROW_SWAP = !bHEAP
+                || std::allocator_traits<Tallocator>::propagate_on_container_swap::value
+                || std::allocator_traits<Tallocator>::is_always_equal::value;
+
+            /**
+             * @brief Destructor that destroys all log entries if destruction is not skipped.
+             */
+            ~deferred_printf_logger() noexcept
+            {
+                if constexpr (!bSKIP_DESTRUCTION)
+                {
+                    for (deferred_printf_log_header & iLog : *this)
+                    {
+                        iLog.destroy();
+                    }
+                }
+            }
+
+            deferred_printf_logger(deferred_printf_logger const &) = delete;
+            deferred_printf_logger &operator=(deferred_printf_logger const &) = delete;
+
+            /**
+             * @brief Move constructor that takes over the log entries, leaving the other logger empty.
+             * @details A buffer on the heap changes hands in O(1): the other logger is left without one, and allocates a new one on its
+             *          next log entry. An inline buffer exchanges only the bytes in use.
+             * 
+             * @param other The other logger, which must not be in use by another thread.
+             */
+            deferred_printf_logger(deferred_printf_logger &&other) noexcept(!bFLUSH)
+                : deferred_printf_logger(fresh_overflow(other.m_Overflow), other.get_allocator(), unallocated_t())
+            {
+                swap(other); // equal allocators, so the buffers are exchanged without allocating
+            }
+
+            /**
+             * @brief Move assignment operator that takes over the log entries, leaving the other logger empty with the previous buffer of this one.
+             * 
+             * @param other The other logger, which must not be in use by another thread.
+             * @return deferred_printf_logger & This logger.
+             */
+            deferred_printf_logger &operator=(deferred_printf_logger &&other) noexcept(bNOTHROW_SWAP)
+            {
+                if (this != &other)
+                {
+                    swap(other);
+                    other.clear();
+                }
+                return *this;
+            }
+
+            /**
+             * @brief Exchanges the log entries, the counters and the overflow policy with another logger.
+             * @details A buffer on the heap or a list of pages is exchanged in O(1); an inline buffer, or a buffer on the heap from a different
+             *          memory resource, exchanges only the bytes in use, which keeps the unused bytes of a concurrent logger zero.
+             * 
+             * @param other The other logger, which must not be in use by another thread.
+             * @throws std::bad_alloc If a buffer left unallocated by a move cannot be allocated to exchange the bytes in use; see bNOTHROW_SWAP.
+             */
+            void swap(deferred_printf_logger &other) noexcept(bNOTHROW_SWAP)
+            {
+                if constexpr (!bGROW) // a segmented logger has no storage of its own; the list of pages is part of the overflow policy
+                {
+                    bool bExchanged = false;
+                    if constexpr (bHEAP)
+                    {
+                        bExchanged = std::allocator_traits<Tallocator>::propagate_on_container_swap::value || get_allocator() == other.get_allocator();
+                        if (bExchanged)
+                        {
+                            m_buffer.swap(other.m_buffer);
+                        }
+                    }
+                    if (!bExchanged) // an inline buffer, or buffers from different memory resources
+                    {
+                        if constexpr (bHEAP)
+                        {
+                            ensure_buffer(); // a buffer that cannot change hands cannot be left behind either
+                            other.ensure_buffer();
+                        }
+                        size_t const zuExtent = (std::min)((std::max)(extent(), other.extent()), zuINLINE);
+                        std::swap_ranges(m_buffer.data(), m_buffer.data() + zuExtent, other.m_buffer.data());
+                    }
+                }
+                swap_counters(m_zuLength, other.m_zuLength);
+                swap_counters(m_zuDropped, other.m_zuDropped);
+                swap_counters(m_zuHighWater, other.m_zuHighWater);
+                std::swap(m_zuLogged, other.m_zuLogged);
+                std::swap(m_zuHead, other.m_zuHead);
+                std::swap(m_zuWrap, other.m_zuWrap);
+                std::swap(m_Overflow, other.m_Overflow);
+            }
+
+            /**
+             * @brief Logs a new entry with the provided tokens.
+             * 
+             * @tparam Ttokens The types of the tokens.
+             * @param tTokens The tokens.
+             */
+            template <typename... Ttokens>
+            void log(Ttokens ... tTokens) noexcept(Toverflow::bNOEXCEPT)
+            {
+                emplace<Cdeferred_printf_log<stored_t<Ttokens>...>>(0, tTokens...);
+            }
+
+            /**
+             * @brief Returns the size of a log entry of the given type.
+             * 
+             * @tparam Tlog The type of the log entry.
+             * @tparam Targs The types of the arguments of its constructor.
+             * @param tArgs The arguments of its constructor.
+             * @return size_t The size, including the copied strings, which follow the fixed part, and the timestamp, which ends the log entry.
+             */
+            template <typename Tlog, typename... Targs>
+            static size_t entry_size(Targs const &... tArgs) noexcept
+            {
+                constexpr size_t zuALIGN = alignof(deferred_printf_log_header);
+                constexpr size_t zuTIMESTAMP = Tclock::bENABLED ? sizeof(uint64_t) : 0;
+                return (sizeof(Tlog) + (inline_size(tArgs) + ... + 0) + zuTIMESTAMP + zuALIGN - 1) & ~(zuALIGN - 1);
+            }
+
+            /**
+             * @brief Constructs a new log entry of the given type in place.
+             * 
+             * @tparam Tlog The type of the log entry.
+             * @tparam Targs The types of the arguments of its constructor.
+             * @param u32Flags The flags of the log entry, e.g. deferred_printf_log_header::severity_flags().
+             * @param tArgs The arguments of its constructor.
+             * @return bool True if the log entry is logged, false if the overflow policy dropped it.
+             */
+            template <typename Tlog, typename... Targs>
+            bool emplace(uint32_t u32Flags, Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+            {
+                static_assert(static_cast<deferred_printf_log_header *>(static_cast<Tlog *>(nullptr)) == nullptr, "We shall reinterpret_cast `Tlog` to `deferred_printf_log_header`, therefore it is to make sure that they have no offset difference");
+                static_assert((!bSKIP_DESTRUCTION) || (std::is_trivially_destructible_v<Tlog>), "Ttokens must be trivially destructible");
+                static_assert(sizeof(Tlog) <= deferred_printf_log_header::u32SIZE_MASK, "The log entry is too large for its 16-bit size");
+                static_assert(!(bRING || bBLOCK || bFLUSH) || (sizeof(Tlog) + (Tclock::bENABLED ? sizeof(uint64_t) : 0) <= zuCAPACITY), "The log entry would never fit, even into an empty logger");
+
+                constexpr size_t zuTIMESTAMP = Tclock::bENABLED ? sizeof(uint64_t) : 0;
+                u32Flags |= Tclock::bENABLED ? deferred_printf_log_header::u32TIMESTAMPED : 0;
+                uint64_t const u64Timestamp = Tclock::now();
+                size_t const zuSize = entry_size<Tlog>(tArgs...);
+                if constexpr ((std::is_same_v<Targs, copied_string> || ...))
+                {
+                    if (zuSize > deferred_printf_log_header::u32SIZE_MASK || ((bRING || bBLOCK || bFLUSH) && zuSize > zuCAPACITY))
+                    {
+                        ++m_zuDropped; // would never fit
+                        return false;
+                    }
+                }
+
+                if constexpr (bCONCURRENT)
+                {
+                    if (char *pcEntry = claim(zuSize))
+                    {
+                        Tlog *pLog = new (pcEntry) Tlog(tArgs...);
+                        std::memcpy(pcEntry + zuSize - zuTIMESTAMP, &u64Timestamp, zuTIMESTAMP);
+                        pLog->publish(zuSize, u32Flags, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (char *pcEntry = reserve(zuSize))
+                {
+                    Tlog *pLog = new (pcEntry) Tlog(tArgs...);
+                    std::memcpy(pcEntry + zuSize - zuTIMESTAMP, &u64Timestamp, zuTIMESTAMP);
+                    pLog->publish(zuSize, u32Flags, std::memory_order_relaxed);
+                    return true;
+                }
+                return false;
+            }
+
+            /**
+             * @brief Visits all log entries and then empties the logger.
+             * @details In concurrent mode, the logger is sealed first, so producers that log in the meantime wait until it is emptied
+             *          instead of applying their overflow policy; they never write into the space being emptied. At most one thread drains at a time; a thread
+             *          that drains meanwhile waits for it to finish, so that clear() and drain() never return with earlier log entries left.
+             * 
+             * @tparam Tvisitor The type of the visitor, callable with a deferred_printf_log_header const &.
+             * @param fnVisitor The visitor.
+             * @param bClose In concurrent mode, whether to leave the logger closed, so that every log entry is dropped until reopen().
+             */
+            template <typename Tvisitor>
+            void drain(Tvisitor &&fnVisitor, bool bClose = false) noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    size_t zuClaimed = m_zuLength.load(std::memory_order_relaxed);
+                    for (;;)
+                    {
+                        if (zuClaimed >= zuUNALLOCATED && bClose)
+                        {
+                            if (m_zuLength.compare_exchange_weak(zuClaimed, zuCLOSED, std::memory_order_acq_rel, std::memory_order_relaxed))
+                            {
+                                return; // closed without a buffer, which reopen() leaves to the next log entry to allocate
+                            }
+                        }
+                        else if (zuClaimed >= zuCLOSED)
+                        {
+                            return; // closed, and left empty by the drain that closed it, or empty without a buffer
+                        }
+                        if (zuClaimed >= zuSEALED)
+                        {
+                            std::this_thread::yield(); // another thread is draining; wait for it, then drain what was logged since
+                            zuClaimed = m_zuLength.load(std::memory_order_relaxed);
+                        }
+                        else if (m_zuLength.compare_exchange_weak(zuClaimed, zuSEALED, std::memory_order_acq_rel, std::memory_order_relaxed))
+                        {
+                            break;
+                        }
+                    }
+                    wait_for_claims(zuClaimed);
+                    for (deferred_printf_log_header const & iLog : *this)
+                    {
+                        fnVisitor(iLog);
+                    }
+                    clear_entries();
+                    std::memset(m_buffer.data(), 0, (std::min)(zuClaimed, zuCAPACITY));
+                    m_zuLength.store(bClose ? zuCLOSED : 0, std::memory_order_release);
+                }
+                else
+                {
+                    for (deferred_printf_log_header const & iLog : *this)
+                    {
+                        fnVisitor(iLog);
+                    }
+                    clear_entries();
+                    m_zuLength = 0;
+                    m_zuLogged = 0;
+                    m_zuHead = 0;
+                    m_zuWrap = zuNO_WRAP;
+                    if constexpr (bGROW)
+                    {
+                        m_Overflow.chunks.clear();
+                    }
+                }
+            }
+
+            /**
+             * @brief Reopens a concurrent logger closed by drain(), so that log entries fit again.
+             */
+            void reopen() noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    m_zuLength.store(bHEAP && m_buffer.empty() ? zuUNALLOCATED : 0, std::memory_order_release);
+                }
+            }
+
+            /**
+             * @brief Returns the number of log entries dropped by the overflow policy.
+             * 
+             * @return size_t The number of dropped log entries.
+             */
+            size_t dropped() const noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    return m_zuDropped.load(std::memory_order_relaxed);
+                }
+                else
+                {
+                    return m_zuDropped;
+                }
+            }
+
+            /**
+             * @brief Empties the logger, destroying its log entries unless destruction is skipped; the buffer is kept for reuse.
+             * @details It drains with a visitor that does nothing, so in concurrent mode it is safe against producers in the same way.
+             */
+            void clear() noexcept
+            {
+                drain([](deferred_printf_log_header const &) {});
+            }
+
+            /**
+             * @brief Returns the allocator of the buffer.
+             * 
+             * @return Tallocator The allocator; a default-constructed one for an inline buffer.
+             */
+            Tallocator get_allocator() const noexcept
+            {
+                if constexpr (bHEAP)
+                {
+                    return m_buffer.get_allocator();
+                }
+                else
+                {
+                    return Tallocator();
+                }
+            }
+
+            /**
+             * @brief Returns the most bytes logged between two drains, updated as log entries are logged.
+             * @details It includes the bytes that the ring buffer discarded, so a logger of this capacity would have held every log entry.
+             * 
+             * @return size_t The number of bytes.
+             */
+            size_t high_water() const noexcept
+            {
+                if constexpr (bCONCURRENT)
+                {
+                    return m_zuHighWater.load(std::memory_order_relaxed);
+                }
+                else
+                {
+                    return m_zuHighWater;
+                }
+            }
+
+            /**
+             * @brief Returns an iterator to the beginning of the log entries.
+             * 
+             * @return iterator The iterator.
+             */
+            iterator begin() noexcept
+            {
+                return first<char>();
+            }
+
+            /**
+             * @brief Returns an iterator to the beginning of the log entries.
+             * 
+             * @return const_iterator The iterator.
+             */
+            const_iterator begin() const noexcept
+            {
+                return first<char const>();
+            }
+
+            /**
+             * @brief Returns an iterator to the end of the log entries.
+             * 
+             * @return iterator The iterator.
+             */
+            iterator end() noexcept
+            {
+                return iterator{const_cast<char *>(committed_end())};
+            }
+
+            /**
+             * @brief Returns an iterator to the end of the log entries.
+             * 
+             * @return const_iterator The iterator.
+             */
+            const_iterator end() const noexcept
+            {
+                return const_iterator{committed_end()};
+            }
+        };
+    }
+
+    /**
+     * @brief Template class for deferred printf functionality.
+     * 
+     * @tparam zuCAPACITY The capacity of the logger.
+     * @tparam bCONCURRENT Whether multiple threads may call operator() at the same time.
+     * @tparam Toverflow The overflow policy: overflow_throw, overflow_overwrite, overflow_drop, overflow_block, overflow_grow or overflow_flush.
+     * @tparam Tclock The clock policy that timestamps each log entry: clock_none, clock_tsc or clock_monotonic.
+     * @tparam Tallocator The allocator of a buffer on the heap, i.e. for a capacity above 4000; see jrmwng::pmr::deferred_printf.
+     */
+    template <size_t zuCAPACITY = 4000, bool bCONCURRENT = false, typename Toverflow = overflow_throw, typename Tclock = clock_none, typename Tallocator = std::allocator<char>>
+    class deferred_printf
+    {
+        using logger_t = details::deferred_printf_logger<zuCAPACITY, bCONCURRENT, Toverflow, Tclock, Tallocator>;
+
+        logger_t m_Logger;
+
+        /**
+         * @brief Logs a new entry with the provided flags, format string and arguments.
+         * 
+         * @tparam Targs The types of the arguments.
+         * @param u32Flags The flags of the log entry.
+         * @param pcFormat The format string.
+         * @param tArgs The arguments.
+         * @return bool True if the log entry is logged, false if the overflow policy dropped it.
+         */
+        template <typename... Targs>
+        bool emplace(uint32_t u32Flags, char const *pcFormat, Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            return m_Logger.template emplace<details::Cdeferred_printf_log<char const *, details::stored_t<Targs>...>>(u32Flags, pcFormat, tArgs...);
+        }
+
+        /**
+         * @brief Logs a new entry with the provided flags, a format string made by DEFERRED_PRINTF_FORMAT, and arguments.
+         * 
+         * @tparam Tformat The type of the format string.
+         * @tparam Targs The types of the arguments.
+         * @param u32Flags The flags of the log entry.
+         * @param tArgs The arguments.
+         * @return bool True if the log entry is logged, false if the overflow policy dropped it.
+         */
+        template <typename Tformat, typename... Targs, typename = std::enable_if_t<std::is_base_of_v<details::format_string, Tformat>>>
+        bool emplace(uint32_t u32Flags, Tformat, Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            return m_Logger.template emplace<details::Cdeferred_printf_planned_log<Tformat, details::stored_t<Targs>...>>(u32Flags, tArgs...);
+        }
+
+        /**
+         * @brief Returns the size of a log entry with the provided format string and arguments.
+         * 
+         * @tparam Targs The types of the arguments.
+         * @param pcFormat The format string.
+         * @param tArgs The arguments.
+         * @return size_t The size.
+         */
+        template <typename... Targs>
+        static size_t entry_size(char const *pcFormat, Targs const &... tArgs) noexcept
+        {
+            return logger_t::template entry_size<details::Cdeferred_printf_log<char const *, details::stored_t<Targs>...>>(pcFormat, tArgs...);
+        }
+
+        /**
+         * @brief Returns the size of a log entry with a format string made by DEFERRED_PRINTF_FORMAT, and arguments.
+         * 
+         * @tparam Tformat The type of the format string.
+         * @tparam Targs The types of the arguments.
+         * @param tArgs The arguments.
+         * @return size_t The size.
+         */
+        template <typename Tformat, typename... Targs, typename = std::enable_if_t<std::is_base_of_v<details::format_string, Tformat>>>
+        static size_t entry_size(Tformat, Targs const &... tArgs) noexcept
+        {
+            return logger_t::template entry_size<details::Cdeferred_printf_planned_log<Tformat, details::stored_t<Targs>...>>(tArgs...);
+        }
+
+        /**
+         * @brief A tally per format string pointer: a log entry with that format string, and the sum of the weights of such entries.
+         */
+        using format_tally_t = std::unordered_map<char const *, std::pair<details::deferred_printf_log_header const *, size_t>>;
+
+        /**
+         * @brief Adds a log entry to a tally per format string pointer, without interning its format string.
+         * 
+         * @param mapTally The tally.
+         * @param iLog The log entry.
+         * @param zuWeight The weight of the log entry, e.g. 1 or its size.
+         */
+        static void tally_format(format_tally_t &mapTally, details::deferred_printf_log_header const &iLog, size_t zuWeight)
+        {
+            auto const pairInserted = mapTally.emplace(iLog.format_string(), std::make_pair(&iLog, size_t(0)));
+            pairInserted.first->second.second += zuWeight;
+        }
+
+        /**
+         * @brief Resolves a tally per format string pointer to a tally per format string ID, interning once per distinct pointer.
+         * 
+         * @param mapTally The tally.
+         * @return std::vector<size_t> The sum of the weights, indexed by the ID of the format string; see details::interned_format().
+         */
+        static std::vector<size_t> resolve_format_tally(format_tally_t const &mapTally)
+        {
+            std::vector<size_t> vecTally;
+            for (auto const &pairTally : mapTally)
+            {
+                uint32_t const u32Id = pairTally.second.first->format_id();
+                if (u32Id >= vecTally.size())
+                {
+                    vecTally.resize((std::max)(size_t(u32Id) + 1, details::interned_format_count()));
+                }
+                vecTally[u32Id] += pairTally.second.second;
+            }
+            return vecTally;
+        }
+    public:
+        using const_iterator = details::deferred_printf_log_iterator<char const>;
+
+        /**
+         * @brief Constructs an empty deferred printf object.
+         */
+        deferred_printf() = default;
+
+        /**
+         * @brief Constructs an empty deferred printf object with the provided overflow policy.
+         * 
+         * @param overflow The overflow policy, e.g. `jrmwng::overflow_flush{ &vprintf }`.
+         */
+        explicit deferred_printf(Toverflow overflow)
+            : m_Logger(std::move(overflow))
+        {}
+
+        /**
+         * @brief Constructs an empty deferred printf object whose buffer comes from the provided allocator.
+         * @details The buffer is not zeroed unless the object is concurrent, so an untouched buffer costs no page faults until it is used.
+         * 
+         * @param allocator The allocator, e.g. a memory resource for jrmwng::pmr::deferred_printf; an inline buffer ignores it.
+         */
+        explicit deferred_printf(Tallocator const &allocator)
+            : m_Logger(Toverflow(), allocator)
+        {}
+
+        /**
+         * @brief Constructs an empty deferred printf object with the provided overflow policy, whose buffer comes from the provided allocator.
+         * 
+         * @param overflow The overflow policy.
+         * @param allocator The allocator; an inline buffer ignores it.
+         */
+        deferred_printf(Toverflow overflow, Tallocator const &allocator)
+            : m_Logger(std::move(overflow), allocator)
+        {}
+
+        deferred_printf(deferred_printf const &) = delete;
+        deferred_printf &operator=(deferred_printf const &) = delete;
+
+        /**
+         * @brief Move constructor that takes over the log entries, in O(1) for a buffer on the heap or a list of pages; the other object
+         *        is left empty, without a buffer on the heap until its next log entry.
+         * 
+         * @param other The other object; neither object may be in use by another thread.
+         */
+        deferred_printf(deferred_printf &&other) = default;
+
+        /**
+         * @brief Move assignment operator that takes over the log entries in O(1) for a buffer on the heap or a list of pages;
+         *        the other object is left empty with the previous buffer of this one.
+         * 
+         * @param other The other object; neither object may be in use by another thread.
+         * @return deferred_printf & This object.
+         */
+        deferred_printf &operator=(deferred_printf &&other) = default;
+
+        /**
+         * @brief Exchanges the log entries with another object, in O(1) for a buffer on the heap or a list of pages.
+         * 
+         * @param other The other object; neither object may be in use by another thread.
+         * @throws std::bad_alloc Only for buffers from unequal memory resources, if one was left without a buffer by a move and cannot allocate it.
+         */
+        void swap(deferred_printf &other) noexcept(logger_t::bNOTHROW_SWAP)
+        {
+            m_Logger.swap(other.m_Logger);
+        }
+
+        /**
+         * @brief The type of a batch of log entries detached from a logger, to be replayed elsewhere, e.g. on another thread.
+         */
+        using log_batch = deferred_printf;
+
+        /**
+         * @brief Detaches the log entries as a batch and leaves this object empty.
+         * @details A buffer on the heap changes hands in O(1), and this object allocates a new one on its next log entry; to avoid that
+         *          allocation, exchange with a spent batch instead.
+         * 
+         * @return log_batch The batch of log entries.
+         */
+        log_batch detach()
+        {
+            return log_batch(std::move(*this));
+        }
+
+        /**
+         * @brief Detaches the log entries into a batch, in exchange for the buffer of the batch, and leaves this object empty.
+         * @details With a buffer on the heap or a list of pages, nothing is copied or allocated, so a producer and a consumer can pass
+         *          two batches back and forth indefinitely.
+         * 
+         * @param batch The spent batch, whose log entries are discarded; it receives the log entries.
+         */
+        void detach(log_batch &batch) noexcept(logger_t::bNOTHROW_SWAP)
+        {
+            batch.clear();
+            swap(batch);
+        }
+
+        /**
+         * @brief Logs a new entry with the provided format string and arguments.
+         * 
+         * @tparam Targs The types of the arguments.
+         * @param pcFormat The format string.
+         * @param tArgs The arguments.
+         */
+        template <typename... Targs>
+        void operator() (char const *pcFormat, Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            emplace(0, pcFormat, tArgs...);
+        }
+
+        /**
+         * @brief Logs a new entry with a format string made by DEFERRED_PRINTF_FORMAT.
+         * @details The format string is parsed at compile time and the arguments are checked against it; a mismatch fails to compile.
+         *          The log entry does not store the format string, and format() replays it without parsing the format string again.
+         * 
+         * @tparam Tformat The type of the format string.
+         * @tparam Targs The types of the arguments.
+         * @param tArgs The arguments.
+         */
+        template <typename Tformat, typename... Targs, typename = std::enable_if_t<std::is_base_of_v<details::format_string, Tformat>>>
+        void operator() (Tformat tFormat, Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            emplace(0, tFormat, tArgs...);
+        }
+
+        /**
+         * @brief Logs a new entry with the provided severity, which is recorded in the log entry.
+         * @details A call below DEFERRED_PRINTF_MIN_SEVERITY logs nothing; a call below the runtime threshold costs a relaxed load. Either way
+         *          the arguments are evaluated at the call site, e.g. `expensive()` in `dp.trace("%d", expensive())`; use DEFERRED_PRINTF_LOG
+         *          to skip their evaluation as well.
+         * 
+         * @tparam eSEVERITY The severity.
+         * @tparam Targs The types of the format string and the arguments.
+         * @param tArgs The format string, possibly made by DEFERRED_PRINTF_FORMAT, and the arguments.
+         */
+        template <severity eSEVERITY, typename... Targs>
+        void log(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            if constexpr (details::compiled_in<eSEVERITY>())
+            {
+                if (eSEVERITY >= severity_threshold())
+                {
+                    emplace(details::deferred_printf_log_header::severity_flags(eSEVERITY), tArgs...);
+                }
+            }
+        }
+
+        /**
+         * @brief Logs a new entry like operator(), and tells whether it was logged, e.g. for a caller that handles a full logger itself.
+         * @details A log entry that the overflow policy drops is still counted by dropped().
+         * 
+         * @tparam Targs The types of the format string and the arguments.
+         * @param tArgs The format string, possibly made by DEFERRED_PRINTF_FORMAT, and the arguments.
+         * @return bool True if the log entry is logged, false if the overflow policy dropped it.
+         */
+        template <typename... Targs>
+        bool try_log(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            return emplace(0, tArgs...);
+        }
+
+        /**
+         * @brief Tells whether a log entry with the provided format string and arguments fits into an empty buffer.
+         * 
+         * @tparam Targs The types of the format string and the arguments.
+         * @param tArgs The format string, possibly made by DEFERRED_PRINTF_FORMAT, and the arguments.
+         * @return bool True if the log entry fits.
+         */
+        template <typename... Targs>
+        static bool fits(Targs const &... tArgs) noexcept
+        {
+            return entry_size(tArgs...) <= (std::min)(zuCAPACITY, size_t(details::deferred_printf_log_header::u32SIZE_MASK));
+        }
+
+        /**
+         * @brief Logs a new entry with severity::trace; see log().
+         */
+        template <typename... Targs>
+        void trace(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            log<severity::trace>(tArgs...);
+        }
+
+        /**
+         * @brief Logs a new entry with severity::debug; see log().
+         */
+        template <typename... Targs>
+        void debug(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            log<severity::debug>(tArgs...);
+        }
+
+        /**
+         * @brief Logs a new entry with severity::info; see log().
+         */
+        template <typename... Targs>
+        void info(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            log<severity::info>(tArgs...);
+        }
+
+        /**
+         * @brief Logs a new entry with severity::warn; see log().
+         */
+        template <typename... Targs>
+        void warn(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            log<severity::warn>(tArgs...);
+        }
 
-            /**
-             * @brief Dereference operator.
-             * 
-             * @return Ideferred_printf_log& The log entry.
-             */
-            reference operator*() const noexcept;
-        };
+        /**
+         * @brief Logs a new entry with severity::error; see log().
+         */
+        template <typename... Targs>
+        void error(Targs ... tArgs) noexcept(Toverflow::bNOEXCEPT)
+        {
+            log<severity::error>(tArgs...);
+        }
 
         /**
-         * @brief Template class for logging deferred log entries.
+         * @brief Applies the provided callback function to all log entries, handling a failing callback, i.e. a negative result, by the failure policy.
+         * @details A sink that died, e.g. with ENOSPC, stops the replay under failure_abort instead of formatting every remaining log entry,
+         *          and the result tells where the output was cut off.
          * 
-         * @tparam zuCAPACITY The capacity of the logger.
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @tparam Tfailure The failure policy: failure_abort, failure_retry or failure_skip.
+         * @param fnCallback The callback function.
+         * @param failure The failure policy.
+         * @return apply_result The bytes written, the log entries replayed, and the first failure.
          */
-        template <size_t zuCAPACITY = 4000>
-        class deferred_printf_logger
+        template <typename Tcallback, typename Tfailure = failure_abort, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        apply_result apply_checked(Tcallback && fnCallback, Tfailure failure = Tfailure()) const noexcept
         {
-            using buffer_t = std::conditional_t<zuCAPACITY <= 4000, std::array<char, zuCAPACITY>, std::vector<char>>;
+            static_assert(std::is_same_v<Tfailure, failure_abort> || std::is_same_v<Tfailure, failure_retry> || std::is_same_v<Tfailure, failure_skip>, "Unsupported failure policy");
 
-            size_t m_zuLength;
-            buffer_t m_buffer;
-        public:
-            /**
-             * @brief Constructs a new deferred printf logger object.
-             */
-            deferred_printf_logger()
-                : m_zuLength(0)
+            details::vprintf_ref const fnVprintf(fnCallback);
+            apply_result result;
+            size_t zuIndex = 0;
+            for (details::deferred_printf_log_header const & iLog : m_Logger)
             {
-                if constexpr (zuCAPACITY <= 4000)
+                int nCount = iLog.apply(fnVprintf);
+                if constexpr (std::is_same_v<Tfailure, failure_retry>)
+                {
+                    for (size_t zuAttempt = 1; nCount < 0 && zuAttempt < failure.zuAttempts; ++zuAttempt)
+                    {
+                        nCount = iLog.apply(fnVprintf);
+                    }
+                }
+                if (nCount < 0)
                 {
-                    //m_buffer.fill(0);
+                    if (result.zuFailed == apply_result::zuNONE)
+                    {
+                        result.zuFailed = zuIndex;
+                        result.nErrno = errno;
+                    }
+                    if constexpr (!std::is_same_v<Tfailure, failure_skip>)
+                    {
+                        break;
+                    }
                 }
                 else
                 {
-                    m_buffer.resize(zuCAPACITY);
+                    result.zuBytes += static_cast<size_t>(nCount);
+                    ++result.zuEntries;
                 }
+                ++zuIndex;
             }
+            return result;
+        }
 
-            /**
-             * @brief Controls whether to skip destruction of log entries.
-             */
-            constexpr static bool bSKIP_DESTRUCTION = true;
+        /**
+         * @brief Applies the provided callback function to all log entries.
+         * @details The callback is referenced through details::vprintf_ref, so applying never allocates. Failing callbacks are skipped;
+         *          use apply_checked() to detect them or to stop at the first one.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int apply(Tcallback && fnCallback) const noexcept
+        {
+            return static_cast<int>(apply_checked(fnCallback, failure_skip()).zuBytes);
+        }
 
-            /**
-             * @brief Destructor that destroys all log entries if destruction is not skipped.
-             */
-            ~deferred_printf_logger() noexcept
+        /**
+         * @brief Applies the provided callback function to the log entries in the provided range that satisfy the provided predicate.
+         * @details Log entries that the predicate rejects are not formatted at all, so replaying a few of many log entries costs little more than iterating them.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @tparam Tpredicate The type of the predicate, callable as `bool(details::deferred_printf_log_header const &)`; it can read
+         *                    the format ID, the severity and the timestamp of the log entry.
+         * @param fnCallback The callback function.
+         * @param itBegin The first log entry, e.g. begin() or tail().
+         * @param itEnd The end of the log entries, e.g. end().
+         * @param fnPredicate The predicate.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename Tpredicate, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list> && std::is_invocable_r_v<bool, Tpredicate &, details::deferred_printf_log_header const &>>>
+        int apply(Tcallback && fnCallback, const_iterator itBegin, const_iterator itEnd, Tpredicate && fnPredicate) const noexcept
+        {
+            details::vprintf_ref const fnVprintf(fnCallback);
+            int nSum = 0;
+            for (; itBegin != itEnd; ++itBegin)
             {
-                if constexpr (!bSKIP_DESTRUCTION)
+                details::deferred_printf_log_header const & iLog = *itBegin;
+                if (fnPredicate(iLog))
                 {
-                    for (Ideferred_printf_log & iLog : *this)
+                    int const nCount = iLog.apply(fnVprintf);
+                    if (nCount > 0)
                     {
-                        iLog.~Ideferred_printf_log();
+                        nSum += nCount;
                     }
                 }
             }
+            return nSum;
+        }
 
-            /**
-             * @brief Logs a new entry with the provided tokens.
-             * 
-             * @tparam Ttokens The types of the tokens.
-             * @param tTokens The tokens.
-             */
-            template <typename... Ttokens>
-            void log(Ttokens ... tTokens)
+        /**
+         * @brief Applies the provided callback function to the log entries in the provided range.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @param itBegin The first log entry, e.g. tail(1000) for the last 1000 log entries.
+         * @param itEnd The end of the log entries, e.g. end().
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int apply(Tcallback && fnCallback, const_iterator itBegin, const_iterator itEnd) const noexcept
+        {
+            return apply(fnCallback, itBegin, itEnd, [](details::deferred_printf_log_header const &) { return true; });
+        }
+
+        /**
+         * @brief Applies the provided callback function to the log entries that satisfy the provided predicate.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @tparam Tpredicate The type of the predicate, callable as `bool(details::deferred_printf_log_header const &)`.
+         * @param fnCallback The callback function.
+         * @param fnPredicate The predicate.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename Tpredicate, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list> && std::is_invocable_r_v<bool, Tpredicate &, details::deferred_printf_log_header const &>>>
+        int apply(Tcallback && fnCallback, Tpredicate && fnPredicate) const noexcept
+        {
+            return apply(fnCallback, begin(), end(), fnPredicate);
+        }
+
+        /**
+         * @brief Applies the provided callback function to the log entries of at least the provided severity.
+         * @details Log entries without a severity, i.e. those logged by operator(), are skipped.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @param eMinimum The minimum severity.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int apply(Tcallback && fnCallback, severity eMinimum) const noexcept
+        {
+            return apply(fnCallback, begin(), end(), [eMinimum](details::deferred_printf_log_header const & iLog)
             {
-                using Tlog = Cdeferred_printf_log<Ttokens...>;
-                static_assert(static_cast<Ideferred_printf_log *>(static_cast<Tlog *>(nullptr)) == nullptr, "We shall reinterpret_cast `Tlog` to `Ideferred_printf_log`, therefore it is to make sure that they have no offset difference");
-                static_assert((!bSKIP_DESTRUCTION) || (std::is_trivially_destructible_v<std::tuple<Ttokens...>>), "Ttokens must be trivially destructible");
+                severity eSeverity;
+                return iLog.level(eSeverity) && eSeverity >= eMinimum;
+            });
+        }
 
-                if (m_zuLength + sizeof(Tlog) <= zuCAPACITY)
+        /**
+         * @brief Applies the provided callback function to all log entries, prefixing each timestamped one with its wall-clock time.
+         * @details The prefix, `"[seconds.nanoseconds] "` since the epoch of std::chrono::system_clock, is spliced as literal text in front of
+         *          the format string of the log entry, so that the callback is called once per log entry, e.g. `&vsprintf, acBuffer` writes
+         *          the whole line. Log entries without a timestamp are applied as is. A format string that does not fit the stack buffer is
+         *          spliced into a heap buffer; if that cannot be allocated, the log entry is skipped like a failing callback.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @param calibration The calibration of Tclock, e.g. `jrmwng::clock_calibration::calibrate<jrmwng::clock_tsc>()`.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int apply(Tcallback && fnCallback, clock_calibration const &calibration) const noexcept
+        {
+            details::vprintf_ref const fnVprintf(fnCallback);
+            char acPrefixed[256];
+            size_t zuPrefix = 0;
+            auto fnPrefixed = [&fnVprintf, &acPrefixed, &zuPrefix](char const *pcFormat, va_list vaArgs) -> int
+            {
+                size_t const zuFormat = strlen(pcFormat) + 1;
+                if (zuPrefix + zuFormat <= sizeof(acPrefixed))
+                {
+                    std::memcpy(acPrefixed + zuPrefix, pcFormat, zuFormat);
+                    return fnVprintf(acPrefixed, vaArgs);
+                }
+                std::unique_ptr<char[]> const pcPrefixed(new (std::nothrow) char[zuPrefix + zuFormat]);
+                if (!pcPrefixed)
+                {
+                    return -1;
+                }
+                std::memcpy(pcPrefixed.get(), acPrefixed, zuPrefix);
+                std::memcpy(pcPrefixed.get() + zuPrefix, pcFormat, zuFormat);
+                return fnVprintf(pcPrefixed.get(), vaArgs);
+            };
+            int nSum = 0;
+            for (details::deferred_printf_log_header const & iLog : m_Logger)
+            {
+                int nCount;
+                uint64_t u64Timestamp;
+                if (iLog.timestamp(u64Timestamp))
                 {
-                    new (m_buffer.data() + m_zuLength) Tlog(tTokens...);
-                    m_zuLength += sizeof(Tlog);
+                    int64_t const i64Nanoseconds = calibration.to_nanoseconds(u64Timestamp);
+                    int64_t const i64Seconds = i64Nanoseconds / 1000000000 - (i64Nanoseconds % 1000000000 < 0);
+                    // Digits only, so the prefix never introduces a conversion specification
+                    zuPrefix = static_cast<size_t>(std::snprintf(acPrefixed, sizeof(acPrefixed), "[%lld.%09lld] ", static_cast<long long>(i64Seconds), static_cast<long long>(i64Nanoseconds - i64Seconds * 1000000000)));
+                    nCount = iLog.apply(fnPrefixed);
                 }
                 else
                 {
-                    throw std::bad_alloc();
+                    nCount = iLog.apply(fnVprintf);
+                }
+                if (nCount > 0)
+                {
+                    nSum += nCount;
                 }
             }
+            return nSum;
+        }
 
-            /**
-             * @brief Returns an iterator to the beginning of the log entries.
-             * 
-             * @return deferred_printf_log_iterator<char> The iterator.
-             */
-            deferred_printf_log_iterator<char> begin() noexcept
+        /**
+         * @brief Applies the provided callback function to all log entries.
+         * @details Kept for compatibility; prefer the template overload, which does not type-erase the callback into a std::function.
+         * 
+         * @param fnCallback The callback function.
+         * @return int The sum of the results of the callback function.
+         */
+        int apply(std::function<int(char const *, va_list)> const & fnCallback) const noexcept
+        {
+            return this->apply<std::function<int(char const *, va_list)> const &>(fnCallback);
+        }
+
+        /**
+         * @brief Formats all log entries with the native formatter, which bypasses va_list and vsnprintf, and passes each of them to a sink.
+         * 
+         * @tparam Tsink The type of the sink, callable as `int(char const *pcText, size_t zuLength)`.
+         * @param pcBuffer The output buffer; a log entry longer than it is truncated.
+         * @param zuSize The size of the output buffer.
+         * @param fnSink The sink.
+         * @return int The sum of the non-negative results of the sink.
+         */
+        template <typename Tsink>
+        int format(char *pcBuffer, size_t zuSize, Tsink && fnSink) const
+        {
+            int nSum = 0;
+            for (details::deferred_printf_log_header const & iLog : m_Logger)
             {
-                return deferred_printf_log_iterator<char>{m_buffer.data()};
+                int const nLength = iLog.format(pcBuffer, zuSize);
+                if (nLength >= 0 && zuSize > 0)
+                {
+                    int const nCount = fnSink(static_cast<char const *>(pcBuffer), (std::min)(static_cast<size_t>(nLength), zuSize - 1));
+                    if (nCount > 0)
+                    {
+                        nSum += nCount;
+                    }
+                }
             }
+            return nSum;
+        }
 
-            /**
-             * @brief Returns an iterator to the beginning of the log entries.
-             * 
-             * @return deferred_printf_log_iterator<char const> The iterator.
-             */
-            deferred_printf_log_iterator<char const> begin() const noexcept
+        /**
+         * @brief Counts the log entries per format string.
+         * 
+         * @return std::vector<size_t> The number of log entries, indexed by the ID of their format string; see details::interned_format().
+         */
+        std::vector<size_t> count_by_format() const
+        {
+            format_tally_t mapTally;
+            for (details::deferred_printf_log_header const & iLog : m_Logger)
             {
-                return deferred_printf_log_iterator<char const>{m_buffer.data()};
+                tally_format(mapTally, iLog, 1);
             }
+            return resolve_format_tally(mapTally);
+        }
 
-            /**
-             * @brief Returns an iterator to the end of the log entries.
-             * 
-             * @return deferred_printf_log_iterator<char> The iterator.
-             */
-            deferred_printf_log_iterator<char> end() noexcept
+        /**
+         * @brief Computes the statistics of the logger.
+         * @details It walks the log entries without formatting them, so logging pays only for keeping the high-water mark; the per-format breakdown is
+         *          tallied per format string pointer and resolved to IDs once per distinct pointer, as count_by_format() does.
+         * 
+         * @return deferred_printf_stats The statistics.
+         */
+        deferred_printf_stats stats() const
+        {
+            deferred_printf_stats result;
+            result.zuCapacity = zuCAPACITY;
+            format_tally_t mapTally;
+            for (details::deferred_printf_log_header const & iLog : m_Logger)
             {
-                return deferred_printf_log_iterator<char>{m_buffer.data() + m_zuLength};
+                size_t const zuSize = iLog.size();
+                ++result.zuEntriesHeld;
+                result.zuBytesHeld += zuSize;
+                ++result.azuSizeHistogram[deferred_printf_stats::size_class(zuSize)];
+                tally_format(mapTally, iLog, zuSize);
             }
+            result.vecBytesByFormat = resolve_format_tally(mapTally);
+            result.zuHighWater = m_Logger.high_water();
+            result.zuDropped = m_Logger.dropped();
+            return result;
+        }
 
-            /**
-             * @brief Returns an iterator to the end of the log entries.
-             * 
-             * @return deferred_printf_log_iterator<char const> The iterator.
-             */
-            deferred_printf_log_iterator<char const> end() const noexcept
+        /**
+         * @brief Writes all log entries in the binary format, leaving the formatting to an offline decoder.
+         * 
+         * @tparam Twriter The type of the writer, e.g. deferred_printf_binary_writer.
+         * @param writer The writer.
+         * @return size_t The number of log entries written.
+         */
+        template <typename Twriter>
+        size_t export_binary(Twriter &writer) const
+        {
+            size_t zuCount = 0;
+            for (details::deferred_printf_log_header const & iLog : m_Logger)
             {
-                return deferred_printf_log_iterator<char const>{m_buffer.data() + m_zuLength};
+                writer.write(iLog);
+                ++zuCount;
             }
-        };
-    }
+            return zuCount;
+        }
 
-    /**
-     * @brief Template class for deferred printf functionality.
-     * 
-     * @tparam zuCAPACITY The capacity of the logger.
-     */
-    template <size_t zuCAPACITY = 4000>
-    class deferred_printf
-    {
-        details::deferred_printf_logger<zuCAPACITY> m_Logger;
-    public:
+        /**
+         * @brief Returns an iterator to the first log entry, e.g. for deferred_printf_merge.
+         * 
+         * @return const_iterator The iterator.
+         */
+        const_iterator begin() const noexcept
+        {
+            return m_Logger.begin();
+        }
 
         /**
-         * @brief Logs a new entry with the provided format string and arguments.
+         * @brief Returns an iterator past the last log entry.
          * 
-         * @tparam Targs The types of the arguments.
-         * @param pcFormat The format string.
-         * @param tArgs The arguments.
+         * @return const_iterator The iterator.
          */
-        template <typename... Targs>
-        void operator() (char const *pcFormat, Targs ... tArgs)
+        const_iterator end() const noexcept
         {
-            m_Logger.log(pcFormat, tArgs...);
+            return m_Logger.end();
         }
 
         /**
-         * @brief Applies the provided callback function to all log entries.
+         * @brief Returns an iterator to the last log entries, e.g. `dp.apply(&vprintf, dp.tail(1000), dp.end())`.
+         * @details It walks the log entries twice without formatting them, since only their sizes link them.
          * 
-         * @param fnCallback The callback function.
-         * @return int The sum of the results of the callback function.
+         * @param zuCount The number of log entries.
+         * @return const_iterator The iterator to the first of the last zuCount log entries, or begin() if there are fewer.
          */
-        int apply(std::function<int(char const *, va_list)> const & fnCallback) const noexcept
+        const_iterator tail(size_t zuCount) const noexcept
         {
-            int nSum = 0;
-            for (details::Ideferred_printf_log const & iLog : m_Logger)
+            size_t zuTotal = 0;
+            for (const_iterator it = begin(), itEnd = end(); it != itEnd; ++it)
             {
-                int const nCount = iLog.apply(fnCallback);
-                if (nCount < 0)
-                {
-                    // TODO
-                }
-                else
-                {
-                    nSum += nCount;
-                }
+                ++zuTotal;
             }
-            return nSum;
+            const_iterator it = begin();
+            for (size_t zuSkip = zuTotal > zuCount ? zuTotal - zuCount : 0; zuSkip > 0; --zuSkip)
+            {
+                ++it;
+            }
+            return it;
         }
 
         /**
@@ -336,11 +3480,133 @@ namespace jrmwng
         template <typename... Tparams>
         int apply(int(*pfnVprintf)(std::decay_t<Tparams> ..., char const *, va_list), Tparams && ... tParams) const
         {
-            std::function<int(char const *, va_list)> const fnVprintf = [&, pfnVprintf](char const *pcFormat, va_list vaArgs)
+            return this->apply([&, pfnVprintf](char const *pcFormat, va_list vaArgs)
             {
                 return pfnVprintf(std::forward<Tparams>(tParams)..., pcFormat, vaArgs);
-            };
-            return this->apply(fnVprintf);
+            });
+        }
+
+        /**
+         * @brief Applies the provided callback function to all log entries and then empties the buffer.
+         * @details In concurrent mode, it may run while other threads keep logging; this is how producers blocked by overflow_block get space back.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int drain(Tcallback && fnCallback) noexcept
+        {
+            details::vprintf_ref const fnVprintf(fnCallback);
+            int nSum = 0;
+            m_Logger.drain([&nSum, fnVprintf](details::deferred_printf_log_header const & iLog)
+            {
+                int const nCount = iLog.apply(fnVprintf);
+                if (nCount > 0)
+                {
+                    nSum += nCount;
+                }
+            });
+            return nSum;
+        }
+
+        /**
+         * @brief Applies the provided callback function to all log entries, empties the buffer, and closes it until reopen().
+         * @details While the buffer is closed, every log entry is dropped, so a producer that still holds the buffer after it has been
+         *          handed off, e.g. by deferred_printf_drainer, cannot log into it out of order.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int drain_and_close(Tcallback && fnCallback) noexcept
+        {
+            static_assert(bCONCURRENT && (std::is_same_v<Toverflow, overflow_drop> || std::is_same_v<Toverflow, overflow_throw>), "Only a concurrent logger that drops or throws can be closed");
+
+            details::vprintf_ref const fnVprintf(fnCallback);
+            int nSum = 0;
+            m_Logger.drain([&nSum, fnVprintf](details::deferred_printf_log_header const & iLog)
+            {
+                int const nCount = iLog.apply(fnVprintf);
+                if (nCount > 0)
+                {
+                    nSum += nCount;
+                }
+            }, true);
+            return nSum;
+        }
+
+        /**
+         * @brief Reopens a buffer closed by drain_and_close(); no thread may drain it at the same time.
+         */
+        void reopen() noexcept
+        {
+            m_Logger.reopen();
+        }
+
+        /**
+         * @brief Empties the buffer without replaying it, keeping the buffer itself for the next log entries.
+         * @details Log entries are destroyed unless destruction is skipped. Unlike assigning a new deferred_printf, it neither allocates
+         *          nor touches the whole buffer, so a logger per request can stay warm in the cache.
+         */
+        void clear() noexcept
+        {
+            m_Logger.clear();
+        }
+
+        /**
+         * @brief Applies the provided callback function to all log entries and then empties the buffer.
+         * @details Kept for compatibility; prefer the template overload, which does not type-erase the callback into a std::function.
+         * 
+         * @param fnCallback The callback function.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        int drain(std::function<int(char const *, va_list)> const & fnCallback) noexcept
+        {
+            return this->drain<std::function<int(char const *, va_list)> const &>(fnCallback);
+        }
+
+        /**
+         * @brief Returns the allocator of the buffer.
+         * 
+         * @return Tallocator The allocator.
+         */
+        Tallocator get_allocator() const noexcept
+        {
+            return m_Logger.get_allocator();
+        }
+
+        /**
+         * @brief Returns the number of log entries dropped by the overflow policy.
+         * 
+         * @return size_t The number of dropped log entries.
+         */
+        size_t dropped() const noexcept
+        {
+            return m_Logger.dropped();
         }
     };
+
+    /**
+     * @brief Exchanges the log entries of two deferred printf objects; see deferred_printf::swap().
+     * 
+     * @param a The first object.
+     * @param b The second object.
+     */
+    template <size_t zuCAPACITY, bool bCONCURRENT, typename Toverflow, typename Tclock, typename Tallocator>
+    void swap(deferred_printf<zuCAPACITY, bCONCURRENT, Toverflow, Tclock, Tallocator> &a, deferred_printf<zuCAPACITY, bCONCURRENT, Toverflow, Tclock, Tallocator> &b) noexcept(noexcept(a.swap(b)))
+    {
+        a.swap(b);
+    }
+
+    namespace pmr
+    {
+        /**
+         * @brief Deferred printf whose buffer comes from a std::pmr::memory_resource, e.g. an arena or a pool of huge pages.
+         * @details Construct it with the memory resource, e.g. `jrmwng::pmr::deferred_printf<1 << 26> dp(&resource)`.
+         */
+        template <size_t zuCAPACITY = 4000, bool bCONCURRENT = false, typename Toverflow = overflow_throw, typename Tclock = clock_none>
+        using deferred_printf = jrmwng::deferred_printf<zuCAPACITY, bCONCURRENT, Toverflow, Tclock, std::pmr::polymorphic_allocator<char>>;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+/// @file deferred_printf_binary.h
+/// @brief Binary export of deferred printf buffers and their offline decoding.
+/// @details This header provides a writer that dumps log entries as raw bytes, together with the descriptors of their types and the strings
+///          they point to, and a reader that turns such a dump back into text, typically in another process or on another machine.
+/// @author jrmwng
+
+#include "deferred_printf.h"
+
+#include <string> // for std::string
+#include <unordered_map> // for std::unordered_map
+#include <unordered_set> // for std::unordered_set
+#include <vector> // for std::vector
+
+namespace jrmwng
+{
+    /**
+     * @brief Writes log entries in the binary format.
+     * @details The output starts with a file header and continues with chunks. Each log entry is written as a raw copy of its bytes,
+     *          preceded by the descriptor of its type on first use and by the strings that its `char const *` tokens point to.
+     *          Format strings are written once per pointer and contents, so a buffer reused for another format string is written again,
+     *          while `%s` arguments are written with every log entry, since their buffers may be reused.
+     *          Strings logged with copy_string() are part of the log entry already, so they need no string chunk.
+     */
+    class deferred_printf_binary_writer
+    {
+        std::function<void(void const *, size_t)> const m_fnWrite;
+
+        std::vector<char> m_vecPending;
+        std::unordered_set<uint32_t> m_setThunk;
+        std::unordered_map<uintptr_t, uint32_t> m_mapFormat; // the ID of the format string last written for each pointer
+
+        /**
+         * @brief Appends raw bytes to the pending output.
+         *
+         * @param pv The bytes.
+         * @param zuSize The number of bytes.
+         */
+        void append(void const *pv, size_t zuSize);
+
+        /**
+         * @brief Appends a string chunk.
+         *
+         * @param pcString The string.
+         */
+        void append_string(char const *pcString);
+    public:
+        /**
+         * @brief Constructs a writer and writes the file header.
+         *
+         * @param fnWrite The function that writes the output, e.g. a wrapper of fwrite.
+         */
+        explicit deferred_printf_binary_writer(std::function<void(void const *, size_t)> fnWrite);
+
+        deferred_printf_binary_writer(deferred_printf_binary_writer const &) = delete;
+        deferred_printf_binary_writer &operator=(deferred_printf_binary_writer const &) = delete;
+
+        /**
+         * @brief Flushes the pending output.
+         */
+        ~deferred_printf_binary_writer() noexcept;
+
+        /**
+         * @brief Writes a log entry.
+         *
+         * @param iLog The log entry.
+         */
+        void write(details::deferred_printf_log_header const &iLog);
+
+        /**
+         * @brief Writes the pending output.
+         */
+        void flush();
+    };
+
+    /**
+     * @brief Reads log entries in the binary format and formats them into text with the native formatter.
+     */
+    class deferred_printf_binary_reader
+    {
+        /**
+         * @brief Decoded descriptor of a type of log entries.
+         */
+        struct descriptor
+        {
+            bool bFormat; // whether strFormat holds the format string, rather than the first token of each log entry
+            std::string strFormat;
+            std::vector<details::deferred_printf_token_desc> vecTokens;
+        };
+
+        std::function<size_t(void *, size_t)> const m_fnRead;
+
+        std::unordered_map<uint32_t, descriptor> m_mapDescriptor;
+        std::unordered_map<uint64_t, std::string> m_mapString;
+        std::vector<char> m_vecRecord;
+        std::vector<details::format_arg> m_vecArgs;
+
+        /**
+         * @brief Reads exactly the given number of bytes.
+         *
+         * @param pv The destination.
+         * @param zuSize The number of bytes.
+         * @return true if all bytes were read, false at the end of the input.
+         */
+        bool read_exactly(void *pv, size_t zuSize);
+
+        /**
+         * @brief Reads a length-prefixed string.
+         *
+         * @return std::string The string.
+         */
+        std::string read_string();
+    public:
+        /**
+         * @brief Constructs a reader and checks the file header.
+         * @throw std::runtime_error if the input is not in the binary format, or was written on a platform with a different byte order.
+         *
+         * @param fnRead The function that reads the input, e.g. a wrapper of fread; it returns the number of bytes read.
+         */
+        explicit deferred_printf_binary_reader(std::function<size_t(void *, size_t)> fnRead);
+
+        /**
+         * @brief Reads the next log entry and formats it.
+         * @throw std::runtime_error if the input is malformed.
+         *
+         * @param strText The formatted log entry.
+         * @return true if a log entry was read, false at the end of the input.
+         */
+        bool read(std::string &strText);
+    };
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+/// @file deferred_printf_drainer.h
+/// @brief Background replay of deferred printf buffers.
+/// @details This header provides a drainer that replays filled deferred_printf buffers on its own consumer thread.
+/// @author jrmwng
+
+#include "deferred_printf.h"
+
+#include <atomic> // for std::atomic
+#include <condition_variable> // for std::condition_variable
+#include <memory> // for std::unique_ptr
+#include <mutex> // for std::mutex, std::unique_lock
+#include <thread> // for std::thread
+
+namespace jrmwng
+{
+    /**
+     * @brief Template class that replays deferred printf buffers on a consumer thread.
+     * @details Producers log into a concurrent active buffer without taking a lock. When the active buffer is full, or on flush(),
+     *          it is swapped with a spare buffer under the lock and handed to the consumer thread, which applies the sink to it and returns
+     *          it as the next spare buffer. Formatting and I/O therefore never run on the producer threads.
+     *
+     * @tparam zuCAPACITY The capacity of each of the two buffers.
+     */
+    template <size_t zuCAPACITY = 4000>
+    class deferred_printf_drainer
+    {
+        using buffer_t = deferred_printf<zuCAPACITY, true, overflow_drop>;
+
+        std::function<int(char const *, va_list)> const m_fnVprintf;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cvConsumer;
+        std::condition_variable m_cvProducer;
+        std::unique_ptr<buffer_t> const m_apBuffers[2];
+        std::atomic<buffer_t *> m_pActive; // logged into without the lock; swapped under it
+        buffer_t *m_pFilled;
+        buffer_t *m_pSpare;
+        std::atomic<size_t> m_zuDropped;
+        bool m_bStop;
+
+        std::thread m_threadConsumer;
+
+        /**
+         * @brief Hands the active buffer to the consumer thread and takes the spare buffer as the new active buffer.
+         *
+         * @param lock The lock held on m_mutex.
+         */
+        void swap_locked(std::unique_lock<std::mutex> &lock)
+        {
+            m_cvProducer.wait(lock, [this]() { return m_pSpare != nullptr; });
+            m_pFilled = m_pActive.load(std::memory_order_relaxed);
+            m_pSpare->reopen();
+            m_pActive.store(m_pSpare, std::memory_order_release);
+            m_pSpare = nullptr;
+            m_cvConsumer.notify_one();
+        }
+
+        /**
+         * @brief Body of the consumer thread.
+         */
+        void consume() noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (;;)
+            {
+                m_cvConsumer.wait(lock, [this]() { return m_pFilled != nullptr || m_bStop; });
+                if (m_pFilled == nullptr)
+                {
+                    break;
+                }
+                buffer_t *pFilled = m_pFilled;
+                m_pFilled = nullptr;
+                lock.unlock();
+                pFilled->drain_and_close(m_fnVprintf); // producers that still hold the buffer cannot log into it until it is active again
+                lock.lock();
+                m_pSpare = pFilled;
+                m_cvProducer.notify_all();
+            }
+        }
+    public:
+        /**
+         * @brief Constructs a drainer and starts its consumer thread.
+         *
+         * @param fnVprintf The vprintf-like function that the consumer thread applies to the filled buffers.
+         */
+        explicit deferred_printf_drainer(std::function<int(char const *, va_list)> fnVprintf)
+            : m_fnVprintf(std::move(fnVprintf))
+            , m_apBuffers{ std::unique_ptr<buffer_t>(new buffer_t), std::unique_ptr<buffer_t>(new buffer_t) }
+            , m_pActive(m_apBuffers[0].get())
+            , m_pFilled(nullptr)
+            , m_pSpare(m_apBuffers[1].get())
+            , m_zuDropped(0)
+            , m_bStop(false)
+            , m_threadConsumer(&deferred_printf_drainer::consume, this)
+        {}
+
+        /**
+         * @brief Constructs a drainer for a vprintf-like function with additional parameters, e.g. `&vfprintf, stderr`.
+         *
+         * @tparam Tparams The types of the additional parameters.
+         * @param pfnVprintf The vprintf-like function.
+         * @param tParams The additional parameters, which are copied into the drainer.
+         */
+        template <typename... Tparams>
+        deferred_printf_drainer(int(*pfnVprintf)(std::decay_t<Tparams> ..., char const *, va_list), Tparams ... tParams)
+            : deferred_printf_drainer([=](char const *pcFormat, va_list vaArgs) { return pfnVprintf(tParams..., pcFormat, vaArgs); })
+        {}
+
+        deferred_printf_drainer(deferred_printf_drainer const &) = delete;
+        deferred_printf_drainer &operator=(deferred_printf_drainer const &) = delete;
+
+        /**
+         * @brief Replays the remaining log entries and stops the consumer thread.
+         */
+        ~deferred_printf_drainer() noexcept
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                swap_locked(lock);
+                m_bStop = true;
+                m_cvConsumer.notify_one();
+            }
+            m_threadConsumer.join();
+        }
+
+        /**
+         * @brief Logs a new entry into the active buffer, swapping buffers when the active buffer is full.
+         * @details The lock is taken only to swap buffers. A log entry larger than zuCAPACITY is dropped and counted by dropped().
+         *
+         * @tparam Targs The types of the arguments.
+         * @param pcFormat The format string.
+         * @param tArgs The arguments.
+         */
+        template <typename... Targs>
+        void operator() (char const *pcFormat, Targs ... tArgs)
+        {
+            if (!buffer_t::fits(pcFormat, tArgs...))
+            {
+                m_zuDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buffer_t *pActive = m_pActive.load(std::memory_order_acquire);
+            while (!pActive->try_log(pcFormat, tArgs...))
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_pActive.load(std::memory_order_relaxed) == pActive) // otherwise another producer has swapped already
+                {
+                    swap_locked(lock);
+                }
+                pActive = m_pActive.load(std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Hands the active buffer to the consumer thread and waits until it has been replayed.
+         */
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            swap_locked(lock);
+            m_cvProducer.wait(lock, [this]() { return m_pSpare != nullptr; });
+        }
+
+        /**
+         * @brief Returns the number of log entries dropped because they did not fit even into an empty buffer.
+         *
+         * @return size_t The number of dropped log entries.
+         */
+        size_t dropped() const noexcept
+        {
+            return m_zuDropped.load(std::memory_order_relaxed);
+        }
+    };
+}
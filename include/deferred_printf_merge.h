@@ -0,0 +1,154 @@
+#pragma once
+
+/// @file deferred_printf_merge.h
+/// @brief Chronological replay of several deferred printf buffers.
+/// @details This header provides a K-way merge that replays the log entries of several loggers, e.g. one per thread, in the order of their timestamps.
+/// @author jrmwng
+
+#include "deferred_printf.h"
+
+#include <algorithm> // for std::push_heap, std::pop_heap
+#include <vector> // for std::vector
+
+namespace jrmwng
+{
+    /**
+     * @brief Replays the log entries of several loggers in the order of their timestamps.
+     * @details Each source is a range of log entries in the order they were logged, so a binary heap of one cursor per source
+     *          yields them in global order, in O(log N) per log entry and without copying them. The loggers must share a clock policy.
+     *          A log entry without a timestamp takes the timestamp of the previous log entry of its source, and ties go to the source added first.
+     */
+    class deferred_printf_merge
+    {
+        using iterator = details::deferred_printf_log_iterator<char const>;
+
+        /**
+         * @brief Position in one source.
+         */
+        struct cursor
+        {
+            uint64_t u64Timestamp; // the timestamp of the log entry at itCurrent
+            size_t zuSource;
+            iterator itCurrent;
+            iterator itEnd;
+
+            /**
+             * @brief Reads the timestamp of the current log entry, keeping the previous one if it has none.
+             */
+            void load() noexcept
+            {
+                (*itCurrent).timestamp(u64Timestamp);
+            }
+        };
+
+        /**
+         * @brief Orders the heap so that its front is the earliest cursor.
+         */
+        struct later
+        {
+            bool operator()(cursor const &cursorLeft, cursor const &cursorRight) const noexcept
+            {
+                return cursorLeft.u64Timestamp != cursorRight.u64Timestamp ? cursorLeft.u64Timestamp > cursorRight.u64Timestamp : cursorLeft.zuSource > cursorRight.zuSource;
+            }
+        };
+
+        std::vector<cursor> m_vecHeap;
+        size_t m_zuSources = 0;
+    public:
+        /**
+         * @brief Adds a range of log entries.
+         * 
+         * @param itBegin The first log entry.
+         * @param itEnd The end of the log entries.
+         */
+        void add(iterator itBegin, iterator itEnd)
+        {
+            size_t const zuSource = m_zuSources++;
+            if (itBegin != itEnd)
+            {
+                m_vecHeap.push_back(cursor{ 0, zuSource, itBegin, itEnd });
+                m_vecHeap.back().load();
+                std::push_heap(m_vecHeap.begin(), m_vecHeap.end(), later());
+            }
+        }
+
+        /**
+         * @brief Adds the log entries of a logger, which must not change until they are replayed.
+         * 
+         * @tparam Tlogger The type of the logger, e.g. deferred_printf.
+         * @param logger The logger.
+         */
+        template <typename Tlogger>
+        void add(Tlogger const &logger)
+        {
+            add(logger.begin(), logger.end());
+        }
+
+        /**
+         * @brief Visits all added log entries in the order of their timestamps, and then forgets them.
+         * 
+         * @tparam Tvisitor The type of the visitor, callable with a details::deferred_printf_log_header const &.
+         * @param fnVisitor The visitor.
+         */
+        template <typename Tvisitor>
+        void visit(Tvisitor &&fnVisitor)
+        {
+            while (!m_vecHeap.empty())
+            {
+                std::pop_heap(m_vecHeap.begin(), m_vecHeap.end(), later());
+                cursor &cursorEarliest = m_vecHeap.back();
+                fnVisitor(*cursorEarliest.itCurrent);
+                if (++cursorEarliest.itCurrent != cursorEarliest.itEnd)
+                {
+                    cursorEarliest.load();
+                    std::push_heap(m_vecHeap.begin(), m_vecHeap.end(), later());
+                }
+                else
+                {
+                    m_vecHeap.pop_back();
+                }
+            }
+            m_zuSources = 0;
+        }
+
+        /**
+         * @brief Applies the provided callback function to all added log entries in the order of their timestamps, and then forgets them.
+         * 
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int apply(Tcallback &&fnCallback)
+        {
+            details::vprintf_ref const fnVprintf(fnCallback);
+            int nSum = 0;
+            visit([&nSum, fnVprintf](details::deferred_printf_log_header const &iLog)
+            {
+                int const nCount = iLog.apply(fnVprintf);
+                if (nCount > 0)
+                {
+                    nSum += nCount;
+                }
+            });
+            return nSum;
+        }
+    };
+
+    /**
+     * @brief Applies the provided callback function to the log entries of the provided loggers in the order of their timestamps.
+     * 
+     * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+     * @tparam Tloggers The types of the loggers.
+     * @param fnCallback The callback function.
+     * @param loggers The loggers.
+     * @return int The sum of the non-negative results of the callback function.
+     */
+    template <typename Tcallback, typename... Tloggers>
+    int merge_apply(Tcallback &&fnCallback, Tloggers const &... loggers)
+    {
+        deferred_printf_merge merge;
+        (merge.add(loggers), ...);
+        return merge.apply(std::forward<Tcallback>(fnCallback));
+    }
+}
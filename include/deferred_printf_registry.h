@@ -0,0 +1,172 @@
+#pragma once
+
+/// @file deferred_printf_registry.h
+/// @brief Thread-local deferred printf buffers with a process-wide registry.
+/// @details This header provides a registry that gives each thread its own logger on first use, and a collector that drains the loggers
+///          of all live and exited threads. It also provides tlog(), which logs into the logger of the calling thread.
+/// @author jrmwng
+
+#include "deferred_printf.h"
+
+#include <memory> // for std::unique_ptr
+#include <mutex> // for std::mutex, std::lock_guard
+#include <vector> // for std::vector
+
+namespace jrmwng
+{
+    /**
+     * @brief Template class that owns one logger per thread.
+     * @details A thread registers its logger the first time it logs, under a lock; after that, logging touches only the cache lines of
+     *          its own logger. The loggers are concurrent, so collect() can drain them while their threads keep logging. A logger outlives
+     *          its thread until collect() has drained it.
+     *
+     * @tparam zuCAPACITY The capacity of each logger.
+     * @tparam Toverflow The overflow policy of each logger: overflow_drop, overflow_block or overflow_throw.
+     * @tparam Tclock The clock policy of each logger.
+     */
+    template <size_t zuCAPACITY = 4000, typename Toverflow = overflow_drop, typename Tclock = clock_none>
+    class deferred_printf_registry
+    {
+    public:
+        using logger_t = deferred_printf<zuCAPACITY, true, Toverflow, Tclock>;
+    private:
+        /**
+         * @brief The logger of a thread, on cache lines of its own.
+         */
+        struct alignas(64) slot
+        {
+            logger_t logger;
+            std::atomic<bool> bExited{ false };
+        };
+
+        /**
+         * @brief Thread-local handle that marks the slot of its thread as exited when the thread exits.
+         */
+        struct handle
+        {
+            slot *const pSlot;
+
+            ~handle() noexcept
+            {
+                pSlot->bExited.store(true, std::memory_order_release);
+            }
+        };
+
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<slot>> m_vecSlots;
+        size_t m_zuDroppedReleased = 0; // the log entries dropped by the loggers that collect() has released
+
+        deferred_printf_registry() = default;
+
+        /**
+         * @brief Registers a new slot.
+         *
+         * @return slot * The slot.
+         */
+        slot *add()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_vecSlots.emplace_back(new slot);
+            return m_vecSlots.back().get();
+        }
+    public:
+        deferred_printf_registry(deferred_printf_registry const &) = delete;
+        deferred_printf_registry &operator=(deferred_printf_registry const &) = delete;
+
+        /**
+         * @brief Returns the process-wide registry of this type.
+         *
+         * @return deferred_printf_registry & The registry.
+         */
+        static deferred_printf_registry &instance()
+        {
+            // Never destroyed, so that threads exiting after main() can still mark their slots
+            static deferred_printf_registry *const s_pRegistry = new deferred_printf_registry;
+            return *s_pRegistry;
+        }
+
+        /**
+         * @brief Returns the logger of the calling thread, registering it on first use.
+         *
+         * @return logger_t & The logger.
+         */
+        static logger_t &local()
+        {
+            thread_local handle const s_handle{ instance().add() };
+            return s_handle.pSlot->logger;
+        }
+
+        /**
+         * @brief Applies the provided callback function to the log entries of all threads, thread by thread, and then empties their loggers.
+         * @details The loggers of exited threads are released once drained. For a single chronological stream, use a clock policy
+         *          and deferred_printf_merge over quiescent loggers instead.
+         *
+         * @tparam Tcallback The type of the callback function, callable as `int(char const *, va_list)`.
+         * @param fnCallback The callback function.
+         * @return int The sum of the non-negative results of the callback function.
+         */
+        template <typename Tcallback, typename = std::enable_if_t<std::is_invocable_r_v<int, Tcallback &, char const *, va_list>>>
+        int collect(Tcallback &&fnCallback)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            int nSum = 0;
+            auto itKeep = m_vecSlots.begin();
+            for (std::unique_ptr<slot> &pSlot : m_vecSlots)
+            {
+                bool const bExited = pSlot->bExited.load(std::memory_order_acquire); // before draining, so that no log entry is left behind
+                nSum += pSlot->logger.drain(fnCallback);
+                if (!bExited)
+                {
+                    *itKeep++ = std::move(pSlot);
+                }
+                else
+                {
+                    m_zuDroppedReleased += pSlot->logger.dropped(); // kept past the logger
+                }
+            }
+            m_vecSlots.erase(itKeep, m_vecSlots.end());
+            return nSum;
+        }
+
+        /**
+         * @brief Returns the number of registered loggers, including those of exited threads not collected yet.
+         *
+         * @return size_t The number of loggers.
+         */
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_vecSlots.size();
+        }
+
+        /**
+         * @brief Returns the number of log entries dropped by the overflow policy, over all registered loggers and those already released.
+         *
+         * @return size_t The number of dropped log entries.
+         */
+        size_t dropped()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t zuDropped = m_zuDroppedReleased;
+            for (std::unique_ptr<slot> const &pSlot : m_vecSlots)
+            {
+                zuDropped += pSlot->logger.dropped();
+            }
+            return zuDropped;
+        }
+    };
+
+    /**
+     * @brief Logs a new entry into the logger of the calling thread in the default registry, e.g. `jrmwng::tlog("id=%d\n", 42)`.
+     * @details It takes the same arguments as deferred_printf::operator(), including a format string made by DEFERRED_PRINTF_FORMAT.
+     *          Collect with `jrmwng::deferred_printf_registry<>::instance().collect(...)`.
+     *
+     * @tparam Targs The types of the format string and the arguments.
+     * @param tArgs The format string and the arguments.
+     */
+    template <typename... Targs>
+    void tlog(Targs ... tArgs)
+    {
+        deferred_printf_registry<>::local()(tArgs...);
+    }
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+/// @file deferred_printf_sink.h
+/// @brief Batched output of deferred printf buffers to a file descriptor.
+/// @details This header provides a sink that formats log entries into a staging buffer and writes the buffer with one system call per batch,
+///          instead of taking the stdio lock for every log entry as vfprintf does.
+/// @author jrmwng
+
+#include "deferred_printf.h"
+
+#include <vector> // for std::vector
+
+namespace jrmwng
+{
+    /**
+     * @brief Sink that coalesces formatted log entries and writes them to a file descriptor in batches.
+     * @details It is callable both as `int(char const *, va_list)`, for deferred_printf::apply(), and as `int(char const *, size_t)`,
+     *          for deferred_printf::format(); write_all() formats with the native formatter straight into the staging buffer.
+     *          A batch is written when the next log entry does not fit below the flush threshold, on flush(), and in the destructor.
+     *          A log entry larger than the threshold is written together with the pending batch by a single writev().
+     *          Once a write fails, every call returns -1, so that apply_checked() stops, and error() tells the errno.
+     */
+    class deferred_printf_fd_sink
+    {
+        int const m_nFd;
+        std::vector<char> m_vecStaging; // the flush threshold plus one byte for the null terminator of vsnprintf
+        size_t m_zuUsed;
+        int m_nErrno;
+
+        /**
+         * @brief Writes the pending batch followed by the provided bytes, retrying partial writes and EINTR.
+         *
+         * @param pcExtra The bytes that follow the pending batch, or nullptr.
+         * @param zuExtra The number of bytes.
+         * @return true on success, false if the write failed.
+         */
+        bool write_through(char const *pcExtra, size_t zuExtra) noexcept;
+
+        /**
+         * @brief Formats text into the staging buffer, flushing first or writing it through if it does not fit.
+         *
+         * @tparam Tformat The type of the formatter, callable as `int(char *, size_t)` with snprintf semantics.
+         * @param fnFormat The formatter, which is called again if the text did not fit the first time.
+         * @return int The length of the text, or -1 on failure.
+         */
+        template <typename Tformat>
+        int stage(Tformat &&fnFormat)
+        {
+            if (m_nErrno != 0)
+            {
+                return -1;
+            }
+            size_t const zuFree = m_vecStaging.size() - m_zuUsed;
+            int const nLength = fnFormat(m_vecStaging.data() + m_zuUsed, zuFree);
+            if (nLength < 0)
+            {
+                return nLength;
+            }
+            if (size_t(nLength) < zuFree)
+            {
+                m_zuUsed += size_t(nLength);
+                return nLength;
+            }
+            if (size_t(nLength) < m_vecStaging.size())
+            {
+                if (!flush())
+                {
+                    return -1;
+                }
+                fnFormat(m_vecStaging.data(), m_vecStaging.size());
+                m_zuUsed = size_t(nLength);
+                return nLength;
+            }
+            std::vector<char> vecLarge(size_t(nLength) + 1);
+            fnFormat(vecLarge.data(), vecLarge.size());
+            return write_through(vecLarge.data(), size_t(nLength)) ? nLength : -1;
+        }
+    public:
+        /**
+         * @brief Constructs a sink for the provided file descriptor, which it does not close.
+         *
+         * @param nFd The file descriptor, e.g. 1 for the standard output.
+         * @param zuThreshold The flush threshold, i.e. the size of a batch.
+         */
+        explicit deferred_printf_fd_sink(int nFd, size_t zuThreshold = 64 * 1024);
+
+        deferred_printf_fd_sink(deferred_printf_fd_sink const &) = delete;
+        deferred_printf_fd_sink &operator=(deferred_printf_fd_sink const &) = delete;
+
+        /**
+         * @brief Writes the pending batch.
+         */
+        ~deferred_printf_fd_sink() noexcept;
+
+        /**
+         * @brief Formats a log entry with vsnprintf into the staging buffer.
+         *
+         * @param pcFormat The format string.
+         * @param vaArgs The arguments.
+         * @return int The length of the formatted text, or -1 on failure.
+         */
+        int operator()(char const *pcFormat, va_list vaArgs);
+
+        /**
+         * @brief Copies formatted text into the staging buffer.
+         *
+         * @param pcText The text.
+         * @param zuLength The length of the text.
+         * @return int The length of the text, or -1 on failure.
+         */
+        int operator()(char const *pcText, size_t zuLength);
+
+        /**
+         * @brief Formats a log entry with the native formatter straight into the staging buffer.
+         *
+         * @param iLog The log entry.
+         * @return int The length of the formatted text, or -1 on failure.
+         */
+        int write(details::deferred_printf_log_header const &iLog);
+
+        /**
+         * @brief Formats all log entries of a logger into the sink, leaving the last batch pending until flush().
+         *
+         * @tparam Tlogger The type of the logger, e.g. deferred_printf.
+         * @param logger The logger.
+         * @return apply_result The bytes staged, the log entries written, and the first failure; nothing is formatted after it.
+         */
+        template <typename Tlogger>
+        apply_result write_all(Tlogger const &logger)
+        {
+            apply_result result;
+            for (details::deferred_printf_log_header const &iLog : logger)
+            {
+                int const nLength = write(iLog);
+                if (nLength < 0)
+                {
+                    result.zuFailed = result.zuEntries;
+                    result.nErrno = m_nErrno;
+                    break;
+                }
+                result.zuBytes += size_t(nLength);
+                ++result.zuEntries;
+            }
+            return result;
+        }
+
+        /**
+         * @brief Writes the pending batch.
+         *
+         * @return true on success, false if the write failed.
+         */
+        bool flush() noexcept;
+
+        /**
+         * @brief Returns the errno of the failed write, or 0 if every write succeeded.
+         *
+         * @return int The errno.
+         */
+        int error() const noexcept
+        {
+            return m_nErrno;
+        }
+    };
+}
@@ -1,9 +1,107 @@
 #include "deferred_printf.h"
 
+#include <cmath> // for std::floor, std::signbit
+#include <cstdio> // for snprintf
+#include <cstring> // for std::memcpy
+#include <exception> // for std::terminate
+#include <memory> // for std::unique_ptr
+#include <new> // for std::nothrow
+#include <string_view> // for std::string_view
+#include <unordered_map> // for std::unordered_map
+
 namespace jrmwng
 {
     namespace details
     {
+        deferred_printf_chunk_list::deferred_printf_chunk_list(deferred_printf_page_pool *pPool) noexcept
+            : m_pPool(pPool)
+            , m_pHead(nullptr)
+            , m_pTail(nullptr)
+        {
+        }
+
+        deferred_printf_chunk_list::deferred_printf_chunk_list(deferred_printf_chunk_list &&other) noexcept
+            : m_pPool(other.m_pPool)
+            , m_pHead(other.m_pHead)
+            , m_pTail(other.m_pTail)
+        {
+            other.m_pHead = other.m_pTail = nullptr;
+        }
+
+        deferred_printf_chunk_list &deferred_printf_chunk_list::operator=(deferred_printf_chunk_list &&other) noexcept
+        {
+            if (this != &other)
+            {
+                clear();
+                m_pPool = other.m_pPool;
+                m_pHead = other.m_pHead;
+                m_pTail = other.m_pTail;
+                other.m_pHead = other.m_pTail = nullptr;
+            }
+            return *this;
+        }
+
+        deferred_printf_chunk_list::~deferred_printf_chunk_list() noexcept
+        {
+            clear();
+        }
+
+        /**
+         * @brief Reserves space in the last chunk, appending a new chunk when it does not fit.
+         * 
+         * @param zuSize The size of the space.
+         * @return char * The reserved space, or nullptr if a new chunk cannot be allocated.
+         */
+        char *deferred_printf_chunk_list::reserve(size_t zuSize) noexcept
+        {
+            if (m_pTail == nullptr || m_pTail->zuLength + zuSize > m_pTail->zuCapacity)
+            {
+                deferred_printf_chunk *pChunk;
+                if (zuSize <= m_pPool->page_size())
+                {
+                    pChunk = m_pPool->acquire();
+                }
+                else if (void *pvChunk = ::operator new(sizeof(deferred_printf_chunk) + zuSize, std::nothrow))
+                {
+                    pChunk = new (pvChunk) deferred_printf_chunk{ nullptr, 0, zuSize }; // larger than a page; never pooled
+                }
+                else
+                {
+                    pChunk = nullptr;
+                }
+                if (pChunk == nullptr)
+                {
+                    return nullptr;
+                }
+                (m_pTail ? m_pTail->pNext : m_pHead) = pChunk;
+                m_pTail = pChunk;
+            }
+            char *pcEntry = m_pTail->data() + m_pTail->zuLength;
+            m_pTail->zuLength += zuSize;
+            return pcEntry;
+        }
+
+        /**
+         * @brief Returns all chunks to the page pool.
+         */
+        void deferred_printf_chunk_list::clear() noexcept
+        {
+            while (m_pHead)
+            {
+                deferred_printf_chunk *pNext = m_pHead->pNext;
+                if (m_pHead->zuCapacity == m_pPool->page_size())
+                {
+                    m_pPool->release(m_pHead);
+                }
+                else
+                {
+                    ::operator delete(m_pHead);
+                }
+                m_pHead = pNext;
+            }
+            m_pTail = nullptr;
+        }
+
         /**
          * @brief Calls the wrapped vprintf-like function with the provided format string and arguments.
          * 
@@ -21,7 +119,617 @@ namespace jrmwng
             return nResult;
         }
 
-        template struct vprintf_wrapper<std::function<int(char const *, va_list)> const &>;
+        template struct vprintf_wrapper<vprintf_ref>;
+
+        namespace
+        {
+            /**
+             * @brief Bounded output of the native formatter, which keeps counting past the end of the output buffer like snprintf.
+             */
+            struct format_output
+            {
+                char *pcOutput;
+                size_t zuSize;
+                size_t zuCount;
+
+                void put(char c) noexcept
+                {
+                    if (zuCount + 1 < zuSize)
+                    {
+                        pcOutput[zuCount] = c;
+                    }
+                    ++zuCount;
+                }
+
+                void put(char const *pc, size_t zuLength) noexcept
+                {
+                    if (zuCount + zuLength < zuSize)
+                    {
+                        for (size_t zu = 0; zu < zuLength; ++zu) // mostly a few characters, for which a call to memcpy would cost more
+                        {
+                            pcOutput[zuCount + zu] = pc[zu];
+                        }
+                    }
+                    else if (zuCount + 1 < zuSize)
+                    {
+                        std::memcpy(pcOutput + zuCount, pc, zuSize - 1 - zuCount);
+                    }
+                    zuCount += zuLength;
+                }
+
+                void pad(char c, size_t zuLength) noexcept
+                {
+                    if (zuCount + 1 < zuSize)
+                    {
+                        std::memset(pcOutput + zuCount, c, (std::min)(zuLength, zuSize - 1 - zuCount));
+                    }
+                    zuCount += zuLength;
+                }
+            };
+
+            /**
+             * @brief Writes a field with padding on the left or right according to the conversion specification.
+             */
+            void put_field(format_output &output, format_spec const &spec, char const *pcPrefix, size_t zuPrefix, size_t zuZeros, char const *pcBody, size_t zuBody) noexcept
+            {
+                size_t const zuField = zuPrefix + zuZeros + zuBody;
+                size_t const zuPad = spec.zuWidth > zuField ? spec.zuWidth - zuField : 0;
+                if (zuPad && !spec.bLeft)
+                {
+                    output.pad(' ', zuPad);
+                }
+                if (zuPrefix)
+                {
+                    output.put(pcPrefix, zuPrefix);
+                }
+                if (zuZeros)
+                {
+                    output.pad('0', zuZeros);
+                }
+                output.put(pcBody, zuBody);
+                if (zuPad && spec.bLeft)
+                {
+                    output.pad(' ', zuPad);
+                }
+            }
+
+            /**
+             * @brief Writes an integer conversion.
+             */
+            void put_integer(format_output &output, format_spec const &spec, format_arg const &arg) noexcept
+            {
+                bool const bSigned = (spec.cConversion == 'd' || spec.cConversion == 'i');
+                size_t const zuBits = 8 * (spec.zuLength ? spec.zuLength : (std::max)(arg.u8Size, static_cast<uint8_t>(sizeof(int))));
+                unsigned long long const ullMask = zuBits >= 64 ? ~0ULL : (1ULL << zuBits) - 1;
+
+                bool bNegative = false;
+                unsigned long long ullValue = arg.ull & ullMask;
+                if (bSigned && zuBits < 64 && (ullValue >> (zuBits - 1)) & 1)
+                {
+                    ullValue |= ~ullMask; // sign-extend
+                }
+                if (bSigned && static_cast<long long>(ullValue) < 0)
+                {
+                    bNegative = true;
+                    ullValue = 0 - ullValue;
+                }
+
+                unsigned const uBase = (spec.cConversion == 'x' || spec.cConversion == 'X') ? 16 : (spec.cConversion == 'o') ? 8 : 10;
+                char const *pcDigits = spec.cConversion == 'X' ? "0123456789ABCDEF" : "0123456789abcdef";
+                char acDigits[24];
+                size_t zuDigits = 0;
+                if (uBase == 10)
+                {
+                    for (unsigned long long ull = ullValue; ull != 0; ull /= 10) // a constant divisor compiles to a multiplication
+                    {
+                        acDigits[sizeof(acDigits) - ++zuDigits] = static_cast<char>('0' + ull % 10);
+                    }
+                }
+                else
+                {
+                    unsigned const uShift = (uBase == 16) ? 4 : 3;
+                    for (unsigned long long ull = ullValue; ull != 0; ull >>= uShift)
+                    {
+                        acDigits[sizeof(acDigits) - ++zuDigits] = pcDigits[ull & (uBase - 1)];
+                    }
+                }
+                if (ullValue == 0 && spec.nPrecision != 0)
+                {
+                    acDigits[sizeof(acDigits) - ++zuDigits] = '0';
+                }
+
+                char acPrefix[2];
+                size_t zuPrefix = 0;
+                if (bNegative)
+                {
+                    acPrefix[zuPrefix++] = '-';
+                }
+                else if (bSigned && spec.bPlus)
+                {
+                    acPrefix[zuPrefix++] = '+';
+                }
+                else if (bSigned && spec.bSpace)
+                {
+                    acPrefix[zuPrefix++] = ' ';
+                }
+                else if (spec.bAlternate && uBase == 16 && ullValue != 0)
+                {
+                    acPrefix[zuPrefix++] = '0';
+                    acPrefix[zuPrefix++] = spec.cConversion;
+                }
+
+                size_t zuZeros = 0;
+                if (spec.nPrecision >= 0)
+                {
+                    zuZeros = static_cast<size_t>(spec.nPrecision) > zuDigits ? spec.nPrecision - zuDigits : 0;
+                }
+                else if (spec.bZero && !spec.bLeft && spec.zuWidth > zuPrefix + zuDigits)
+                {
+                    zuZeros = spec.zuWidth - zuPrefix - zuDigits;
+                }
+                if (spec.bAlternate && uBase == 8 && zuZeros == 0 && (zuDigits == 0 || acDigits[sizeof(acDigits) - zuDigits] != '0'))
+                {
+                    zuZeros = 1;
+                }
+                put_field(output, spec, acPrefix, zuPrefix, zuZeros, acDigits + sizeof(acDigits) - zuDigits, zuDigits);
+            }
+
+            /**
+             * @brief Writes a %f conversion of a double without snprintf, if rounding it to the precision is unambiguous.
+             * @details The scaled value is rounded once by the multiplication, by at most half an ulp, so unless its fraction is that close
+             *          to one half, it rounds to the same digits as the exact binary value does in printf.
+             * 
+             * @return bool True if written, false if snprintf has to write it.
+             */
+            bool put_fixed(format_output &output, format_spec const &spec, double d) noexcept
+            {
+                constexpr double adPOW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+                size_t const zuPrecision = spec.nPrecision < 0 ? 6 : static_cast<size_t>(spec.nPrecision);
+                if (zuPrecision >= sizeof(adPOW10) / sizeof(adPOW10[0]) || !(std::fabs(d) < 1e15)) // also rejects NaN
+                {
+                    return false;
+                }
+                double const dScaled = std::fabs(d) * adPOW10[zuPrecision];
+                if (dScaled >= 9007199254740992.0) // 2^53, beyond which the scaled value has no fraction
+                {
+                    return false;
+                }
+                double const dFloor = std::floor(dScaled);
+                double const dFraction = dScaled - dFloor;
+                if (std::fabs(dFraction - 0.5) <= dScaled * 2.3e-16)
+                {
+                    return false;
+                }
+                unsigned long long ullValue = static_cast<unsigned long long>(dFloor) + (dFraction > 0.5 ? 1 : 0);
+
+                char acBody[32];
+                char *pcEnd = acBody + sizeof(acBody);
+                for (size_t zu = 0; zu < zuPrecision; ++zu, ullValue /= 10)
+                {
+                    *--pcEnd = static_cast<char>('0' + ullValue % 10);
+                }
+                if (zuPrecision > 0 || spec.bAlternate)
+                {
+                    *--pcEnd = '.';
+                }
+                do
+                {
+                    *--pcEnd = static_cast<char>('0' + ullValue % 10);
+                    ullValue /= 10;
+                }
+                while (ullValue);
+                size_t const zuBody = static_cast<size_t>(acBody + sizeof(acBody) - pcEnd);
+
+                char cSign = std::signbit(d) ? '-' : spec.bPlus ? '+' : spec.bSpace ? ' ' : '\0';
+                size_t const zuPrefix = cSign ? 1 : 0;
+                size_t const zuZeros = spec.bZero && !spec.bLeft && spec.zuWidth > zuPrefix + zuBody ? spec.zuWidth - zuPrefix - zuBody : 0;
+                put_field(output, spec, &cSign, zuPrefix, zuZeros, pcEnd, zuBody);
+                return true;
+            }
+
+            /**
+             * @brief Writes a floating-point conversion, natively for most %f conversions and by delegating it to snprintf otherwise.
+             */
+            void put_floating(format_output &output, format_spec const &spec, format_arg const &arg) noexcept
+            {
+                if ((spec.cConversion == 'f' || spec.cConversion == 'F') && arg.eType != format_arg::type::ldbl && put_fixed(output, spec, arg.d))
+                {
+                    return;
+                }
+
+                char acSpec[16];
+                size_t zuSpec = 0;
+                acSpec[zuSpec++] = '%';
+                if (spec.bLeft)
+                {
+                    acSpec[zuSpec++] = '-';
+                }
+                if (spec.bPlus)
+                {
+                    acSpec[zuSpec++] = '+';
+                }
+                if (spec.bSpace)
+                {
+                    acSpec[zuSpec++] = ' ';
+                }
+                if (spec.bAlternate)
+                {
+                    acSpec[zuSpec++] = '#';
+                }
+                if (spec.bZero)
+                {
+                    acSpec[zuSpec++] = '0';
+                }
+                acSpec[zuSpec++] = '*';
+                acSpec[zuSpec++] = '.';
+                acSpec[zuSpec++] = '*';
+                if (arg.eType == format_arg::type::ldbl)
+                {
+                    acSpec[zuSpec++] = 'L';
+                }
+                acSpec[zuSpec++] = spec.cConversion;
+                acSpec[zuSpec] = '\0';
+
+                char *pcTail = output.pcOutput + (std::min)(output.zuCount, output.zuSize);
+                size_t const zuTail = output.zuSize > output.zuCount ? output.zuSize - output.zuCount : 0;
+                int const nLength = arg.eType == format_arg::type::ldbl
+                    ? snprintf(pcTail, zuTail, acSpec, static_cast<int>(spec.zuWidth), spec.nPrecision, arg.ld)
+                    : snprintf(pcTail, zuTail, acSpec, static_cast<int>(spec.zuWidth), spec.nPrecision, arg.d);
+                if (nLength > 0)
+                {
+                    output.zuCount += nLength;
+                }
+            }
+
+            /**
+             * @brief Writes a conversion, taking its arguments from the provided ones.
+             * @details A conversion that is unsupported, lacks its argument or mismatches it is written verbatim.
+             */
+            void put_conversion(format_output &output, format_spec spec, char const *pcSpec, size_t zuSpec, format_arg const *pArgs, size_t zuArgs, size_t &zuArg) noexcept
+            {
+                if (spec.cConversion == '%')
+                {
+                    output.put('%');
+                    return;
+                }
+                if (spec.bWidthArg)
+                {
+                    long long const llWidth = zuArg < zuArgs ? pArgs[zuArg++].ll : 0;
+                    spec.bLeft |= llWidth < 0;
+                    spec.zuWidth = static_cast<size_t>(llWidth < 0 ? -llWidth : llWidth);
+                }
+                if (spec.bPrecisionArg)
+                {
+                    long long const llPrecision = zuArg < zuArgs ? pArgs[zuArg++].ll : 0;
+                    spec.nPrecision = llPrecision < 0 ? -1 : static_cast<int>(llPrecision);
+                }
+                if (spec.cConversion == 'n')
+                {
+                    ++zuArg; // never written through
+                    return;
+                }
+                if (zuArg >= zuArgs)
+                {
+                    output.put(pcSpec, zuSpec); // missing argument
+                    return;
+                }
+                format_arg const &arg = pArgs[zuArg++];
+                bool const bInteger = (arg.eType == format_arg::type::sint || arg.eType == format_arg::type::uint);
+                bool const bFloating = (arg.eType == format_arg::type::dbl || arg.eType == format_arg::type::ldbl);
+
+                switch (spec.cConversion)
+                {
+                case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+                    if (bInteger)
+                    {
+                        put_integer(output, spec, arg);
+                        return;
+                    }
+                    break;
+                case 'c':
+                    if (bInteger)
+                    {
+                        char const c = static_cast<char>(arg.ull);
+                        put_field(output, spec, nullptr, 0, 0, &c, 1);
+                        return;
+                    }
+                    break;
+                case 's':
+                    if (arg.eType == format_arg::type::str || (arg.eType == format_arg::type::ptr && arg.pv == nullptr))
+                    {
+                        char const *pcString = arg.pc ? arg.pc : "(null)";
+                        size_t const zuString = spec.nPrecision < 0 ? std::strlen(pcString) : strnlen(pcString, spec.nPrecision);
+                        put_field(output, spec, nullptr, 0, 0, pcString, zuString);
+                        return;
+                    }
+                    break;
+                case 'p':
+                    if (arg.eType == format_arg::type::ptr || arg.eType == format_arg::type::str)
+                    {
+                        if (arg.pv == nullptr)
+                        {
+                            put_field(output, spec, nullptr, 0, 0, "(nil)", 5);
+                        }
+                        else
+                        {
+                            format_spec specHex = spec;
+                            specHex.bAlternate = true;
+                            specHex.cConversion = 'x';
+                            specHex.zuLength = sizeof(void const *);
+                            format_arg argHex = arg;
+                            argHex.ull = reinterpret_cast<uintptr_t>(arg.pv);
+                            put_integer(output, specHex, argHex);
+                        }
+                        return;
+                    }
+                    break;
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    if (bFloating)
+                    {
+                        put_floating(output, spec, arg);
+                        return;
+                    }
+                    break;
+                }
+                output.put(pcSpec, zuSpec); // unsupported conversion or mismatching argument
+            }
+
+            /**
+             * @brief Null-terminates the output and returns its length.
+             */
+            int finish(format_output const &output) noexcept
+            {
+                if (output.zuSize > 0)
+                {
+                    output.pcOutput[(std::min)(output.zuCount, output.zuSize - 1)] = '\0';
+                }
+                return static_cast<int>(output.zuCount);
+            }
+        }
+
+        /**
+         * @brief Formats the provided arguments like snprintf, without going through a va_list.
+         * 
+         * @param pcOutput The output buffer, which is always null-terminated unless zuSize is 0.
+         * @param zuSize The size of the output buffer.
+         * @param pcFormat The format string.
+         * @param pArgs The arguments.
+         * @param zuArgs The number of arguments.
+         * @return int The number of characters that would have been written if the output buffer were large enough, excluding the null terminator.
+         */
+        int format_args(char *pcOutput, size_t zuSize, char const *pcFormat, format_arg const *pArgs, size_t zuArgs) noexcept
+        {
+            format_output output{ pcOutput, zuSize, 0 };
+            size_t zuArg = 0;
+            for (char const *pc = pcFormat; *pc; )
+            {
+                if (*pc != '%')
+                {
+                    output.put(*pc++);
+                    continue;
+                }
+                char const *pcSpec = pc;
+                format_spec spec;
+                pc = parse_format_spec(pc + 1, spec);
+                if (spec.cConversion == 0)
+                {
+                    break;
+                }
+                put_conversion(output, spec, pcSpec, pc - pcSpec, pArgs, zuArgs, zuArg);
+            }
+            return finish(output);
+        }
+
+        /**
+         * @brief Formats the provided arguments by a precomputed format plan, without parsing the format string.
+         * 
+         * @param pcOutput The output buffer, which is always null-terminated unless zuSize is 0.
+         * @param zuSize The size of the output buffer.
+         * @param pcFormat The format string.
+         * @param pDirectives The directives of the format string.
+         * @param zuDirectives The number of directives.
+         * @param pArgs The arguments.
+         * @param zuArgs The number of arguments.
+         * @return int The number of characters that would have been written if the output buffer were large enough, excluding the null terminator.
+         */
+        int format_planned_args(char *pcOutput, size_t zuSize, char const *pcFormat, format_directive const *pDirectives, size_t zuDirectives, format_arg const *pArgs, size_t zuArgs) noexcept
+        {
+            format_output output{ pcOutput, zuSize, 0 };
+            size_t zuArg = 0;
+            for (format_directive const *pDirective = pDirectives; pDirective < pDirectives + zuDirectives; ++pDirective)
+            {
+                output.put(pcFormat + pDirective->zuText, pDirective->zuTextLength);
+                if (pDirective->spec.cConversion != 0)
+                {
+                    put_conversion(output, pDirective->spec, pcFormat + pDirective->zuText + pDirective->zuTextLength, pDirective->zuSpecLength, pArgs, zuArgs, zuArg);
+                }
+            }
+            return finish(output);
+        }
+
+        namespace
+        {
+            /**
+             * @brief Process-wide table of registered objects, indexed by dense indices.
+             * @details The table is a two-level page table, so that looking up an index needs no lock. Pages are never freed.
+             * 
+             * @tparam T The type of the registered objects, which must have static storage duration.
+             */
+            template <typename T>
+            class registry
+            {
+                constexpr static size_t zuPAGE_SIZE = 256;
+                constexpr static size_t zuPAGE_COUNT = 256;
+
+                using page_t = std::array<T const *, zuPAGE_SIZE>;
+
+                std::atomic<page_t *> m_apPage[zuPAGE_COUNT] = {};
+                std::atomic<size_t> m_zuCount = { 0 };
+            public:
+                std::mutex mutex;
+
+                /**
+                 * @brief Adds an object; the caller holds the mutex.
+                 * 
+                 * @param pObject The object.
+                 * @return uint32_t The index of the object.
+                 */
+                uint32_t add(T const *pObject) noexcept
+                {
+                    size_t const zuIndex = m_zuCount.load(std::memory_order_relaxed);
+                    if (zuIndex >= zuPAGE_SIZE * zuPAGE_COUNT)
+                    {
+                        std::terminate(); // more than any program is expected to have
+                    }
+                    std::atomic<page_t *> &apPage = m_apPage[zuIndex / zuPAGE_SIZE];
+                    page_t *pPage = apPage.load(std::memory_order_relaxed);
+                    if (pPage == nullptr)
+                    {
+                        pPage = new page_t();
+                    }
+                    (*pPage)[zuIndex % zuPAGE_SIZE] = pObject;
+                    apPage.store(pPage, std::memory_order_release);
+                    m_zuCount.store(zuIndex + 1, std::memory_order_release);
+                    return static_cast<uint32_t>(zuIndex);
+                }
+
+                /**
+                 * @brief Returns a registered object.
+                 * 
+                 * @param u32Index The index returned by add().
+                 * @return T const * The object.
+                 */
+                T const *at(uint32_t u32Index) const noexcept
+                {
+                    page_t const *pPage = m_apPage[u32Index / zuPAGE_SIZE].load(std::memory_order_acquire);
+                    return (*pPage)[u32Index % zuPAGE_SIZE];
+                }
+
+                /**
+                 * @brief Returns the number of registered objects.
+                 * 
+                 * @return size_t The number of registered objects.
+                 */
+                size_t size() const noexcept
+                {
+                    return m_zuCount.load(std::memory_order_acquire);
+                }
+            };
+
+            registry<deferred_printf_thunk> g_registryThunk;
+            registry<char> g_registryFormat;
+
+            /**
+             * @brief Returns the index of the interned format strings by their contents; guarded by the mutex of g_registryFormat.
+             */
+            std::unordered_map<std::string_view, uint32_t> &format_ids()
+            {
+                // Never destroyed, like the registries, so that loggers with static storage duration can still intern at exit
+                static std::unordered_map<std::string_view, uint32_t> *const s_pmapFormat = new std::unordered_map<std::string_view, uint32_t>();
+                return *s_pmapFormat;
+            }
+        }
+
+        /**
+         * @brief Registers a thunk in the process-wide thunk table.
+         * 
+         * @param thunk The thunk, which must have static storage duration.
+         * @return uint32_t The index of the thunk.
+         */
+        uint32_t register_thunk(deferred_printf_thunk const &thunk) noexcept
+        {
+            std::lock_guard<std::mutex> lock(g_registryThunk.mutex);
+            return g_registryThunk.add(&thunk);
+        }
+
+        /**
+         * @brief Returns a registered thunk.
+         * 
+         * @param u32Index The index returned by register_thunk().
+         * @return deferred_printf_thunk const & The thunk.
+         */
+        deferred_printf_thunk const &thunk_at(uint32_t u32Index) noexcept
+        {
+            return *g_registryThunk.at(u32Index);
+        }
+
+        /**
+         * @brief Interns a format string.
+         * 
+         * @param pcFormat The format string, which must outlive the process-wide registry, e.g. a string literal.
+         * @return uint32_t The ID of the format string, which is shared by all format strings with the same contents.
+         */
+        uint32_t intern_format(char const *pcFormat) noexcept
+        {
+            std::lock_guard<std::mutex> lock(g_registryFormat.mutex);
+            auto const pairInserted = format_ids().emplace(pcFormat, 0);
+            if (pairInserted.second)
+            {
+                pairInserted.first->second = g_registryFormat.add(pcFormat);
+            }
+            return pairInserted.first->second;
+        }
+
+        /**
+         * @brief Interns a copy of a format string whose contents are not interned yet, e.g. one built at run time.
+         * @details A per-thread cache, keyed by the address of the format string and checked against the contents of the interned
+         *          copy, answers repeated queries without the lock; a buffer reused for another format string misses the cache.
+         * 
+         * @param pcFormat The format string, which may be freed afterwards.
+         * @return uint32_t The ID of the format string, which is shared by all format strings with the same contents.
+         */
+        uint32_t intern_format_copy(char const *pcFormat)
+        {
+            struct cached_format
+            {
+                char const *pcFormat;
+                uint32_t u32Id;
+            };
+            constexpr size_t zuCACHE_SIZE = 64;
+            thread_local cached_format t_aCache[zuCACHE_SIZE] = {};
+
+            cached_format &cached = t_aCache[std::hash<char const *>()(pcFormat) % zuCACHE_SIZE];
+            if (cached.pcFormat == pcFormat && std::strcmp(g_registryFormat.at(cached.u32Id), pcFormat) == 0)
+            {
+                return cached.u32Id;
+            }
+
+            std::string_view const svFormat(pcFormat);
+            std::lock_guard<std::mutex> lock(g_registryFormat.mutex);
+            auto itFound = format_ids().find(svFormat);
+            if (itFound == format_ids().end())
+            {
+                std::unique_ptr<char[]> pcCopy(new char[svFormat.size() + 1]);
+                std::memcpy(pcCopy.get(), pcFormat, svFormat.size() + 1);
+                itFound = format_ids().emplace(std::string_view(pcCopy.get(), svFormat.size()), 0).first; // keyed by the copy, never by the caller's string
+                itFound->second = g_registryFormat.add(pcCopy.release()); // never freed, like the registry that refers to it
+            }
+            cached = { pcFormat, itFound->second };
+            return itFound->second;
+        }
+
+        /**
+         * @brief Returns an interned format string.
+         * 
+         * @param u32Id The ID returned by intern_format() or intern_format_copy().
+         * @return char const * The format string.
+         */
+        char const *interned_format(uint32_t u32Id) noexcept
+        {
+            return g_registryFormat.at(u32Id);
+        }
+
+        /**
+         * @brief Returns the number of interned format strings, which bounds their IDs.
+         * 
+         * @return size_t The number of interned format strings.
+         */
+        size_t interned_format_count() noexcept
+        {
+            return g_registryFormat.size();
+        }
+
+        std::atomic<severity> g_eSeverityThreshold(severity::trace);
 
         /**
          * @brief Constructs a deferred_printf_log_iterator with the given buffer.
@@ -31,7 +739,52 @@ namespace jrmwng
         template <typename Tchar>
         deferred_printf_log_iterator<Tchar>::deferred_printf_log_iterator(Tchar *pcBuffer) noexcept
             : m_pBuffer(pcBuffer)
+            , m_pWrap(nullptr)
+            , m_pBase(pcBuffer)
+            , m_pChunk(nullptr)
+        {
+        }
+
+        /**
+         * @brief Constructs a deferred_printf_log_iterator with the given buffer and wrap point.
+         * 
+         * @param pcBuffer Pointer to the buffer.
+         * @param pcWrap Pointer at which the iterator continues with pChunk, or from pcBase if there is no chunk; nullptr if there is no wrap point.
+         * @param pcBase Pointer to the beginning of the ring buffer.
+         * @param pChunk Pointer to the chunk that continues the buffer, or nullptr.
+         */
+        template <typename Tchar>
+        deferred_printf_log_iterator<Tchar>::deferred_printf_log_iterator(Tchar *pcBuffer, Tchar *pcWrap, Tchar *pcBase, deferred_printf_chunk const *pChunk) noexcept
+            : m_pBuffer(pcBuffer)
+            , m_pWrap(pcWrap)
+            , m_pBase(pcBase)
+            , m_pChunk(pChunk)
         {
+            follow();
+        }
+
+        /**
+         * @brief Moves past the end of the current segment of log entries while the iterator is there.
+         * @details A segment ends either at the wrap point of a ring buffer, which continues from the beginning of the buffer,
+         *          or at the end of a buffer that is continued by a chunk.
+         */
+        template <typename Tchar>
+        void deferred_printf_log_iterator<Tchar>::follow() noexcept
+        {
+            while (m_pWrap && m_pBuffer == m_pWrap)
+            {
+                if (m_pChunk)
+                {
+                    m_pBuffer = m_pChunk->data();
+                    m_pWrap = m_pChunk->pNext ? m_pChunk->data() + m_pChunk->zuLength : nullptr;
+                    m_pChunk = m_pChunk->pNext;
+                }
+                else
+                {
+                    m_pBuffer = m_pBase;
+                    m_pWrap = nullptr;
+                }
+            }
         }
 
         /**
@@ -54,7 +807,8 @@ namespace jrmwng
         template <typename Tchar>
         deferred_printf_log_iterator<Tchar> &deferred_printf_log_iterator<Tchar>::operator++() noexcept
         {
-            m_pBuffer += reinterpret_cast<Ideferred_printf_log const *>(m_pBuffer)->size();
+            m_pBuffer += reinterpret_cast<deferred_printf_log_header const *>(m_pBuffer)->size();
+            follow();
             return *this;
         }
 
@@ -66,7 +820,7 @@ namespace jrmwng
         template <typename Tchar>
         typename deferred_printf_log_iterator<Tchar>::reference deferred_printf_log_iterator<Tchar>::operator*() const noexcept
         {
-            return *reinterpret_cast<std::conditional_t<std::is_const_v<Tchar>, Ideferred_printf_log const, Ideferred_printf_log> *>(m_pBuffer);
+            return *reinterpret_cast<std::conditional_t<std::is_const_v<Tchar>, deferred_printf_log_header const, deferred_printf_log_header> *>(m_pBuffer);
         }
 
         template class Cdeferred_printf_log<char const *>;
@@ -77,5 +831,94 @@ namespace jrmwng
 
         // Explicit instantiation of deferred_printf_logger with default capacity
         template class deferred_printf_logger<>;
+        template class deferred_printf_logger<4000, true>;
+        template class deferred_printf_logger<4000, false, overflow_overwrite>;
+        template class deferred_printf_logger<4000, false, overflow_drop>;
+        template class deferred_printf_logger<4000, true, overflow_block>;
+        template class deferred_printf_logger<4000, false, overflow_grow>;
+        template class deferred_printf_logger<4000, false, overflow_flush>;
+    }
+
+    deferred_printf_page_pool::deferred_printf_page_pool(size_t zuPageSize) noexcept
+        : m_zuPageSize(zuPageSize)
+        , m_pFree(nullptr)
+        , m_zuFree(0)
+    {
+    }
+
+    deferred_printf_page_pool::~deferred_printf_page_pool() noexcept
+    {
+        while (m_pFree)
+        {
+            details::deferred_printf_chunk *pNext = m_pFree->pNext;
+            ::operator delete(m_pFree);
+            m_pFree = pNext;
+        }
+    }
+
+    /**
+     * @brief Takes a page from the pool, allocating one if the pool is empty.
+     * 
+     * @return details::deferred_printf_chunk * The page, or nullptr if it cannot be allocated.
+     */
+    details::deferred_printf_chunk *deferred_printf_page_pool::acquire() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (details::deferred_printf_chunk *pPage = m_pFree)
+            {
+                m_pFree = pPage->pNext;
+                --m_zuFree;
+                pPage->pNext = nullptr;
+                return pPage;
+            }
+        }
+        void *pvPage = ::operator new(sizeof(details::deferred_printf_chunk) + m_zuPageSize, std::nothrow);
+        return pvPage ? new (pvPage) details::deferred_printf_chunk{ nullptr, 0, m_zuPageSize } : nullptr;
+    }
+
+    /**
+     * @brief Returns a page to the pool.
+     * 
+     * @param pPage The page, which must have been acquired from this pool.
+     */
+    void deferred_printf_page_pool::release(details::deferred_printf_chunk *pPage) noexcept
+    {
+        pPage->zuLength = 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pPage->pNext = m_pFree;
+        m_pFree = pPage;
+        ++m_zuFree;
+    }
+
+    /**
+     * @brief Allocates pages up front, so that later growth does not hit the heap.
+     * 
+     * @param zuPages The number of pages to add to the pool.
+     * @return bool True if all pages are allocated.
+     */
+    bool deferred_printf_page_pool::preallocate(size_t zuPages) noexcept
+    {
+        for (size_t zu = 0; zu < zuPages; ++zu)
+        {
+            void *pvPage = ::operator new(sizeof(details::deferred_printf_chunk) + m_zuPageSize, std::nothrow);
+            if (pvPage == nullptr)
+            {
+                return false;
+            }
+            release(new (pvPage) details::deferred_printf_chunk{ nullptr, 0, m_zuPageSize });
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of pages available in the pool.
+     * 
+     * @return size_t The number of pages.
+     */
+    size_t deferred_printf_page_pool::free_pages() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_zuFree;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,409 @@
+#include "deferred_printf_binary.h"
+
+#include <cstddef> // for offsetof
+
+namespace jrmwng
+{
+    namespace
+    {
+        constexpr char acMAGIC[4] = { 'D', 'P', 'F', 'B' };
+        constexpr uint32_t u32VERSION = 1;
+        constexpr uint32_t u32BYTE_ORDER = 0x01020304;
+
+        constexpr char cCHUNK_DESCRIPTOR = 'D';
+        constexpr char cCHUNK_STRING = 'S';
+        constexpr char cCHUNK_RECORD = 'R';
+
+        constexpr uint32_t u32NO_FORMAT = ~uint32_t(0);
+
+        constexpr size_t zuFLUSH_THRESHOLD = 64 * 1024;
+
+        /**
+         * @brief Loads a pointer token of a log entry.
+         */
+        uintptr_t load_pointer(char const *pcRecord, details::deferred_printf_token_desc const &token) noexcept
+        {
+            void const *pv;
+            std::memcpy(&pv, pcRecord + token.u16Offset, sizeof(pv));
+            return reinterpret_cast<uintptr_t>(pv);
+        }
+
+        /**
+         * @brief Loads an integer token of the given size, sign-extending it if it is signed.
+         */
+        template <typename Tsigned, typename Tunsigned>
+        unsigned long long load_integer(char const *pc, bool bSigned) noexcept
+        {
+            if (bSigned)
+            {
+                Tsigned t;
+                std::memcpy(&t, pc, sizeof(t));
+                return static_cast<unsigned long long>(static_cast<long long>(t));
+            }
+            Tunsigned t;
+            std::memcpy(&t, pc, sizeof(t));
+            return static_cast<unsigned long long>(t);
+        }
+    }
+
+    deferred_printf_binary_writer::deferred_printf_binary_writer(std::function<void(void const *, size_t)> fnWrite)
+        : m_fnWrite(std::move(fnWrite))
+    {
+        append(acMAGIC, sizeof(acMAGIC));
+        append(&u32VERSION, sizeof(u32VERSION));
+        append(&u32BYTE_ORDER, sizeof(u32BYTE_ORDER));
+    }
+
+    deferred_printf_binary_writer::~deferred_printf_binary_writer() noexcept
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    void deferred_printf_binary_writer::append(void const *pv, size_t zuSize)
+    {
+        if (zuSize == 0)
+        {
+            return;
+        }
+        size_t const zuPending = m_vecPending.size();
+        m_vecPending.resize(zuPending + zuSize);
+        std::memcpy(m_vecPending.data() + zuPending, pv, zuSize);
+    }
+
+    void deferred_printf_binary_writer::append_string(char const *pcString)
+    {
+        uint64_t const u64Pointer = reinterpret_cast<uintptr_t>(pcString);
+        uint32_t const u32Length = static_cast<uint32_t>(std::strlen(pcString));
+        append(&cCHUNK_STRING, 1);
+        append(&u64Pointer, sizeof(u64Pointer));
+        append(&u32Length, sizeof(u32Length));
+        append(pcString, u32Length);
+    }
+
+    void deferred_printf_binary_writer::write(details::deferred_printf_log_header const &iLog)
+    {
+        details::deferred_printf_thunk const &thunk = details::thunk_at(iLog.u32Thunk);
+        if (m_setThunk.insert(iLog.u32Thunk).second)
+        {
+            uint32_t const u32Format = thunk.pcFormat ? static_cast<uint32_t>(std::strlen(thunk.pcFormat)) : u32NO_FORMAT;
+            append(&cCHUNK_DESCRIPTOR, 1);
+            append(&iLog.u32Thunk, sizeof(iLog.u32Thunk));
+            append(&u32Format, sizeof(u32Format));
+            if (thunk.pcFormat)
+            {
+                append(thunk.pcFormat, u32Format);
+            }
+            append(&thunk.u32Tokens, sizeof(thunk.u32Tokens));
+            append(thunk.pTokens, thunk.u32Tokens * sizeof(details::deferred_printf_token_desc));
+        }
+
+        // Only the format string and the arguments of %s conversions are read as strings; a char * printed by %p may point anywhere
+        char const *pcRecord = reinterpret_cast<char const *>(&iLog);
+        char const *pcFormat = thunk.pcFormat;
+        uint32_t u32Token = 0;
+        if (pcFormat == nullptr && thunk.u32Tokens > 0 && thunk.pTokens[0].eType == details::format_arg::type::str)
+        {
+            uintptr_t const uPointer = load_pointer(pcRecord, thunk.pTokens[u32Token++]);
+            pcFormat = reinterpret_cast<char const *>(uPointer);
+            if (uPointer != 0)
+            {
+                uint32_t const u32Id = details::intern_format_copy(pcFormat); // by contents, since the buffer may have been reused
+                auto const pairInserted = m_mapFormat.emplace(uPointer, u32Id);
+                if (pairInserted.second || pairInserted.first->second != u32Id)
+                {
+                    pairInserted.first->second = u32Id;
+                    append_string(pcFormat);
+                }
+            }
+        }
+        for (char const *pc = pcFormat; pc && *pc; )
+        {
+            if (*pc++ != '%')
+            {
+                continue;
+            }
+            details::format_spec spec;
+            pc = details::parse_format_spec(pc, spec);
+            if (spec.cConversion == 0)
+            {
+                break;
+            }
+            if (spec.cConversion == '%')
+            {
+                continue;
+            }
+            u32Token += (spec.bWidthArg ? 1 : 0) + (spec.bPrecisionArg ? 1 : 0);
+            if (u32Token >= thunk.u32Tokens)
+            {
+                break;
+            }
+            details::deferred_printf_token_desc const &token = thunk.pTokens[u32Token++];
+            if (spec.cConversion == 's' && token.eType == details::format_arg::type::str)
+            {
+                if (uintptr_t const uPointer = load_pointer(pcRecord, token))
+                {
+                    append_string(reinterpret_cast<char const *>(uPointer));
+                }
+            }
+        }
+
+        uint32_t const u32Size = static_cast<uint32_t>(iLog.size());
+        append(&cCHUNK_RECORD, 1);
+        append(&u32Size, sizeof(u32Size));
+        append(pcRecord, u32Size);
+
+        if (m_vecPending.size() >= zuFLUSH_THRESHOLD)
+        {
+            flush();
+        }
+    }
+
+    void deferred_printf_binary_writer::flush()
+    {
+        if (!m_vecPending.empty())
+        {
+            m_fnWrite(m_vecPending.data(), m_vecPending.size());
+            m_vecPending.clear();
+        }
+    }
+
+    deferred_printf_binary_reader::deferred_printf_binary_reader(std::function<size_t(void *, size_t)> fnRead)
+        : m_fnRead(std::move(fnRead))
+    {
+        char acMagic[sizeof(acMAGIC)];
+        uint32_t u32Version;
+        uint32_t u32ByteOrder;
+        if (!read_exactly(acMagic, sizeof(acMagic)) || std::memcmp(acMagic, acMAGIC, sizeof(acMAGIC)) != 0 ||
+            !read_exactly(&u32Version, sizeof(u32Version)) || u32Version != u32VERSION)
+        {
+            throw std::runtime_error("Not a deferred_printf binary log");
+        }
+        if (!read_exactly(&u32ByteOrder, sizeof(u32ByteOrder)) || u32ByteOrder != u32BYTE_ORDER)
+        {
+            throw std::runtime_error("The binary log was written with a different byte order");
+        }
+    }
+
+    bool deferred_printf_binary_reader::read_exactly(void *pv, size_t zuSize)
+    {
+        char *pc = static_cast<char *>(pv);
+        while (zuSize > 0)
+        {
+            size_t const zuRead = m_fnRead(pc, zuSize);
+            if (zuRead == 0)
+            {
+                return false;
+            }
+            pc += zuRead;
+            zuSize -= zuRead;
+        }
+        return true;
+    }
+
+    std::string deferred_printf_binary_reader::read_string()
+    {
+        uint32_t u32Length;
+        if (!read_exactly(&u32Length, sizeof(u32Length)))
+        {
+            throw std::runtime_error("Truncated binary log");
+        }
+        std::string str(u32Length, '\0');
+        if (!read_exactly(&str[0], u32Length))
+        {
+            throw std::runtime_error("Truncated binary log");
+        }
+        return str;
+    }
+
+    bool deferred_printf_binary_reader::read(std::string &strText)
+    {
+        for (;;)
+        {
+            char cChunk;
+            if (!read_exactly(&cChunk, 1))
+            {
+                return false;
+            }
+            if (cChunk == cCHUNK_DESCRIPTOR)
+            {
+                uint32_t u32Thunk;
+                uint32_t u32Format;
+                if (!read_exactly(&u32Thunk, sizeof(u32Thunk)) || !read_exactly(&u32Format, sizeof(u32Format)))
+                {
+                    throw std::runtime_error("Truncated binary log");
+                }
+                descriptor desc;
+                desc.bFormat = (u32Format != u32NO_FORMAT);
+                if (desc.bFormat)
+                {
+                    desc.strFormat.resize(u32Format);
+                    if (!read_exactly(&desc.strFormat[0], u32Format))
+                    {
+                        throw std::runtime_error("Truncated binary log");
+                    }
+                }
+                uint32_t u32Tokens;
+                if (!read_exactly(&u32Tokens, sizeof(u32Tokens)))
+                {
+                    throw std::runtime_error("Truncated binary log");
+                }
+                desc.vecTokens.resize(u32Tokens);
+                if (!read_exactly(desc.vecTokens.data(), u32Tokens * sizeof(details::deferred_printf_token_desc)))
+                {
+                    throw std::runtime_error("Truncated binary log");
+                }
+                m_mapDescriptor[u32Thunk] = std::move(desc);
+            }
+            else if (cChunk == cCHUNK_STRING)
+            {
+                uint64_t u64Pointer;
+                if (!read_exactly(&u64Pointer, sizeof(u64Pointer)))
+                {
+                    throw std::runtime_error("Truncated binary log");
+                }
+                m_mapString[u64Pointer] = read_string();
+            }
+            else if (cChunk == cCHUNK_RECORD)
+            {
+                uint32_t u32Size;
+                if (!read_exactly(&u32Size, sizeof(u32Size)) || u32Size < sizeof(details::deferred_printf_log_header))
+                {
+                    throw std::runtime_error("Truncated binary log");
+                }
+                m_vecRecord.resize(u32Size);
+                if (!read_exactly(m_vecRecord.data(), u32Size))
+                {
+                    throw std::runtime_error("Truncated binary log");
+                }
+                break;
+            }
+            else
+            {
+                throw std::runtime_error("Malformed binary log");
+            }
+        }
+
+        uint32_t u32Thunk;
+        std::memcpy(&u32Thunk, m_vecRecord.data() + offsetof(details::deferred_printf_log_header, u32Thunk), sizeof(u32Thunk));
+        auto const itDescriptor = m_mapDescriptor.find(u32Thunk);
+        if (itDescriptor == m_mapDescriptor.end())
+        {
+            throw std::runtime_error("Log entry of an undescribed type");
+        }
+        descriptor const &desc = itDescriptor->second;
+
+        char const *pcFormat = desc.bFormat ? desc.strFormat.c_str() : nullptr;
+        m_vecArgs.clear();
+        for (details::deferred_printf_token_desc const &token : desc.vecTokens)
+        {
+            if (size_t(token.u16Offset) + token.u8Size > m_vecRecord.size())
+            {
+                throw std::runtime_error("Malformed binary log");
+            }
+            char const *pc = m_vecRecord.data() + token.u16Offset;
+            details::format_arg arg;
+            arg.eType = token.eType;
+            arg.u8Size = token.u8Size;
+            arg.ull = 0;
+            switch (token.eType)
+            {
+            case details::format_arg::type::sint:
+            case details::format_arg::type::uint:
+                {
+                    bool const bSigned = (token.eType == details::format_arg::type::sint);
+                    switch (token.u8Size)
+                    {
+                    case 1: arg.ull = load_integer<int8_t, uint8_t>(pc, bSigned); break;
+                    case 2: arg.ull = load_integer<int16_t, uint16_t>(pc, bSigned); break;
+                    case 4: arg.ull = load_integer<int32_t, uint32_t>(pc, bSigned); break;
+                    case 8: arg.ull = load_integer<int64_t, uint64_t>(pc, bSigned); break;
+                    default: throw std::runtime_error("Malformed binary log");
+                    }
+                }
+                break;
+            case details::format_arg::type::dbl:
+                if (token.u8Size == sizeof(float))
+                {
+                    float f;
+                    std::memcpy(&f, pc, sizeof(f));
+                    arg.d = f;
+                }
+                else
+                {
+                    std::memcpy(&arg.d, pc, (std::min)(size_t(token.u8Size), sizeof(arg.d)));
+                }
+                break;
+            case details::format_arg::type::ldbl:
+                arg.ld = 0;
+                std::memcpy(&arg.ld, pc, (std::min)(size_t(token.u8Size), sizeof(arg.ld)));
+                break;
+            case details::format_arg::type::str:
+            case details::format_arg::type::ptr:
+                {
+                    uint64_t u64Pointer = 0;
+                    if (token.u8Size == sizeof(uint32_t))
+                    {
+                        uint32_t u32Pointer;
+                        std::memcpy(&u32Pointer, pc, sizeof(u32Pointer));
+                        u64Pointer = u32Pointer;
+                    }
+                    else
+                    {
+                        std::memcpy(&u64Pointer, pc, (std::min)(size_t(token.u8Size), sizeof(u64Pointer)));
+                    }
+                    auto const itString = token.eType == details::format_arg::type::str ? m_mapString.find(u64Pointer) : m_mapString.end();
+                    if (itString != m_mapString.end())
+                    {
+                        arg.pc = itString->second.c_str();
+                    }
+                    else
+                    {
+                        arg.eType = details::format_arg::type::ptr; // a char * that was not written as a string, e.g. for %p
+                        arg.pv = reinterpret_cast<void const *>(static_cast<uintptr_t>(u64Pointer));
+                    }
+                }
+                break;
+            case details::format_arg::type::inline_str:
+                {
+                    details::inline_string inline_token;
+                    std::memcpy(&inline_token, pc, sizeof(inline_token));
+                    size_t const zuEnd = size_t(inline_token.u16Offset) + inline_token.u16Length; // the position of the null terminator
+                    if (inline_token.u16Offset != 0 && (zuEnd >= m_vecRecord.size() || m_vecRecord[zuEnd] != '\0'))
+                    {
+                        throw std::runtime_error("Malformed binary log");
+                    }
+                    arg.eType = details::format_arg::type::str;
+                    arg.u8Size = sizeof(char const *);
+                    arg.pc = inline_token.u16Offset ? m_vecRecord.data() + inline_token.u16Offset : nullptr; // copied into the record itself
+                }
+                break;
+            }
+            if (pcFormat == nullptr)
+            {
+                pcFormat = arg.eType == details::format_arg::type::str && arg.pc ? arg.pc : "";
+                continue;
+            }
+            m_vecArgs.push_back(arg);
+        }
+        if (pcFormat == nullptr)
+        {
+            throw std::runtime_error("Log entry without a format string");
+        }
+
+        strText.resize((std::max)(strText.capacity(), size_t(256)));
+        size_t const zuLength = static_cast<size_t>(details::format_args(&strText[0], strText.size(), pcFormat, m_vecArgs.data(), m_vecArgs.size()));
+        if (zuLength >= strText.size())
+        {
+            strText.resize(zuLength + 1);
+            details::format_args(&strText[0], strText.size(), pcFormat, m_vecArgs.data(), m_vecArgs.size());
+        }
+        strText.resize(zuLength);
+        return true;
+    }
+}
@@ -0,0 +1,147 @@
+#include "deferred_printf_sink.h"
+
+#include <cstdio> // for vsnprintf
+
+#if defined(_WIN32)
+#include <io.h> // for _write
+#else
+#include <sys/uio.h> // for writev
+#include <unistd.h> // for write
+#endif
+
+namespace jrmwng
+{
+    namespace
+    {
+        /**
+         * @brief Writes a sequence of buffers, retrying partial writes and EINTR.
+         *
+         * @param nFd The file descriptor.
+         * @param apcBuffer The buffers.
+         * @param azuLength The lengths of the buffers, which are consumed.
+         * @param zuBuffers The number of buffers.
+         * @return true on success, false if a write failed; errno tells why.
+         */
+        bool write_buffers(int nFd, char const *apcBuffer[], size_t azuLength[], size_t zuBuffers) noexcept
+        {
+            size_t zuFirst = 0;
+            while (zuFirst < zuBuffers)
+            {
+                if (azuLength[zuFirst] == 0)
+                {
+                    ++zuFirst;
+                    continue;
+                }
+#if defined(_WIN32)
+                int const nWritten = ::_write(nFd, apcBuffer[zuFirst], static_cast<unsigned>((std::min)(azuLength[zuFirst], size_t(1) << 30)));
+                long long const llWritten = nWritten;
+#else
+                iovec aIovec[2];
+                int nIovec = 0;
+                for (size_t zu = zuFirst; zu < zuBuffers && nIovec < 2; ++zu)
+                {
+                    aIovec[nIovec].iov_base = const_cast<char *>(apcBuffer[zu]);
+                    aIovec[nIovec].iov_len = azuLength[zu];
+                    ++nIovec;
+                }
+                long long const llWritten = ::writev(nFd, aIovec, nIovec);
+#endif
+                if (llWritten < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                size_t zuWritten = static_cast<size_t>(llWritten);
+                while (zuWritten > 0)
+                {
+                    size_t const zuConsumed = (std::min)(zuWritten, azuLength[zuFirst]);
+                    apcBuffer[zuFirst] += zuConsumed;
+                    azuLength[zuFirst] -= zuConsumed;
+                    zuWritten -= zuConsumed;
+                    if (azuLength[zuFirst] == 0)
+                    {
+                        ++zuFirst;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    deferred_printf_fd_sink::deferred_printf_fd_sink(int nFd, size_t zuThreshold)
+        : m_nFd(nFd)
+        , m_vecStaging((std::max)(zuThreshold, size_t(1)) + 1)
+        , m_zuUsed(0)
+        , m_nErrno(0)
+    {}
+
+    deferred_printf_fd_sink::~deferred_printf_fd_sink() noexcept
+    {
+        flush();
+    }
+
+    bool deferred_printf_fd_sink::write_through(char const *pcExtra, size_t zuExtra) noexcept
+    {
+        if (m_nErrno != 0)
+        {
+            return false;
+        }
+        char const *apcBuffer[2] = { m_vecStaging.data(), pcExtra };
+        size_t azuLength[2] = { m_zuUsed, pcExtra ? zuExtra : 0 };
+        m_zuUsed = 0;
+        if (!write_buffers(m_nFd, apcBuffer, azuLength, 2))
+        {
+            m_nErrno = errno ? errno : EIO;
+            return false;
+        }
+        return true;
+    }
+
+    bool deferred_printf_fd_sink::flush() noexcept
+    {
+        return write_through(nullptr, 0);
+    }
+
+    int deferred_printf_fd_sink::operator()(char const *pcFormat, va_list vaArgs)
+    {
+        va_list vaCopy;
+        va_copy(vaCopy, vaArgs);
+        bool bFirst = true;
+        int const nLength = stage([&](char *pcOutput, size_t zuSize) {
+            int nResult;
+            if (bFirst)
+            {
+                nResult = std::vsnprintf(pcOutput, zuSize, pcFormat, vaArgs);
+                bFirst = false;
+            }
+            else
+            {
+                nResult = std::vsnprintf(pcOutput, zuSize, pcFormat, vaCopy); // only one retry ever happens
+            }
+            return nResult;
+        });
+        va_end(vaCopy);
+        return nLength;
+    }
+
+    int deferred_printf_fd_sink::operator()(char const *pcText, size_t zuLength)
+    {
+        return stage([pcText, zuLength](char *pcOutput, size_t zuSize) {
+            if (zuLength < zuSize)
+            {
+                std::memcpy(pcOutput, pcText, zuLength);
+            }
+            return static_cast<int>(zuLength);
+        });
+    }
+
+    int deferred_printf_fd_sink::write(details::deferred_printf_log_header const &iLog)
+    {
+        return stage([&iLog](char *pcOutput, size_t zuSize) {
+            return iLog.format(pcOutput, zuSize);
+        });
+    }
+}
@@ -1,10 +1,24 @@
 #include "deferred_printf.h"
+#include "deferred_printf_binary.h"
+#include "deferred_printf_drainer.h"
+#include "deferred_printf_merge.h"
+#include "deferred_printf_registry.h"
+#include "deferred_printf_sink.h"
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cassert>
 #include <cstdio>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
 
 #ifdef _MSC_VER
 #pragma warning(disable : 4996) // Suppress warning: 'fopen' is deprecated
@@ -215,6 +229,1452 @@ void test_dynamic_buffer_allocation()
     assert(std::string(buffer.data()) == "Dynamic buffer 5 6");
 }
 
+void test_concurrent_logging()
+{
+    constexpr int nTHREADS = 8;
+    constexpr int nENTRIES = 1000;
+
+    jrmwng::deferred_printf<1024 * 1024, true> logger;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nTHREADS; ++t)
+    {
+        threads.emplace_back([&logger, t]() {
+            for (int i = 0; i < nENTRIES; ++i)
+            {
+                logger("%d %d", t, i);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<int> next(nTHREADS, 0);
+    int nEntries = 0;
+    logger.apply([&](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        int t = -1, i = -1;
+        sscanf(buffer, "%d %d", &t, &i);
+        assert(t >= 0 && t < nTHREADS);
+        assert(next[t] == i); // entries of one thread keep their order
+        ++next[t];
+        ++nEntries;
+        return 0;
+    });
+
+    assert(nEntries == nTHREADS * nENTRIES);
+    assert(std::all_of(next.begin(), next.end(), [](int n) { return n == nENTRIES; }));
+}
+
+void test_concurrent_overflow()
+{
+    jrmwng::deferred_printf<256, true> logger;
+
+    int nLogged = 0;
+    try
+    {
+        for (;;)
+        {
+            logger("Entry %d", nLogged);
+            ++nLogged;
+        }
+    }
+    catch (std::bad_alloc const &)
+    {
+    }
+
+    int nEntries = 0;
+    logger.apply([&](char const *, va_list) -> int {
+        ++nEntries;
+        return 0;
+    });
+    assert(nLogged > 0);
+    assert(nEntries == nLogged);
+}
+
+void test_drain_while_logging()
+{
+    constexpr int nTHREADS = 4;
+    constexpr int nENTRIES = 2000;
+
+    // A drain in progress seals the logger, which is not full; producers wait for it instead of throwing or dropping
+    jrmwng::deferred_printf<1024 * 1024, true> logger;
+    jrmwng::deferred_printf<1024 * 1024, true, jrmwng::overflow_drop> loggerDrop;
+    std::atomic<int> nThrown(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nTHREADS; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < nENTRIES; ++i)
+            {
+                try
+                {
+                    logger("%d %d", t, i);
+                }
+                catch (std::bad_alloc const &)
+                {
+                    ++nThrown;
+                }
+                loggerDrop("%d %d", t, i);
+            }
+        });
+    }
+
+    int nEntries = 0;
+    int nEntriesDrop = 0;
+    auto const count = [](int &n) {
+        return [&n](char const *, va_list) -> int {
+            ++n;
+            return 0;
+        };
+    };
+    while (nEntries + nThrown < nTHREADS * nENTRIES || nEntriesDrop + static_cast<int>(loggerDrop.dropped()) < nTHREADS * nENTRIES)
+    {
+        logger.drain(count(nEntries));
+        loggerDrop.drain(count(nEntriesDrop));
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    assert(nThrown == 0 && nEntries == nTHREADS * nENTRIES);
+    assert(loggerDrop.dropped() == 0 && nEntriesDrop == nTHREADS * nENTRIES);
+}
+
+void test_compact_header()
+{
+    using Tlog = jrmwng::details::Cdeferred_printf_log<char const *, int>;
+    static_assert(sizeof(jrmwng::details::deferred_printf_log_header) == 8, "The header shall be as small as a vtable pointer");
+    static_assert(sizeof(Tlog) == sizeof(jrmwng::details::deferred_printf_log_header) + sizeof(char const *) + sizeof(int), "The header shall be the only overhead of a log entry");
+
+    // A concurrent logger shall pack as many log entries as a single-producer logger of the same capacity
+    jrmwng::deferred_printf<sizeof(Tlog) * 4> logger;
+    jrmwng::deferred_printf<sizeof(Tlog) * 4, true> loggerConcurrent;
+    for (int i = 0; i < 4; ++i)
+    {
+        logger("Entry %d", i);
+        loggerConcurrent("Entry %d", i);
+    }
+
+    std::string strOutput;
+    int nEntries = loggerConcurrent.apply([&](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[32];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strOutput += acBuffer;
+        return nCount;
+    });
+    assert(nEntries == 4 * 7);
+    assert(strOutput == "Entry 0Entry 1Entry 2Entry 3");
+}
+
+void test_packed_tokens()
+{
+    using Ttuple = std::tuple<char const *, int, double>;
+    using Tlog = jrmwng::details::Cdeferred_printf_log<char const *, int, double>;
+    static_assert(sizeof(Tlog) < sizeof(jrmwng::details::deferred_printf_log_header) + sizeof(Ttuple), "Packed tokens shall take less space than a tuple");
+
+    jrmwng::deferred_printf<4000> logger;
+    logger("%c|%d|%.1f|%s|%.2Lf", 'x', 42, 2.5, "str", 1.25L);
+    logger("%hd|%lld|%c", short(-7), 1234567890123LL, 'y');
+
+    std::string strOutput;
+    logger.apply([&](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[64];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strOutput += acBuffer;
+        strOutput += '\n';
+        return nCount;
+    });
+    assert(strOutput == "x|42|2.5|str|1.25\n-7|1234567890123|y\n");
+}
+
+static int count_vprintf(char const *pcFormat, va_list vaArgs)
+{
+    return vsnprintf(nullptr, 0, pcFormat, vaArgs);
+}
+
+void test_template_callback()
+{
+    jrmwng::deferred_printf<> logger;
+    logger("Entry %d", 1);
+    logger("Entry %d", 22);
+
+    // A mutable callable is invoked in place, without being copied into a std::function
+    struct Ccounter
+    {
+        int nCalls = 0;
+        int operator() (char const *pcFormat, va_list vaArgs)
+        {
+            ++nCalls;
+            return vsnprintf(nullptr, 0, pcFormat, vaArgs);
+        }
+    } counter;
+    assert(logger.apply(counter) == 15);
+    assert(counter.nCalls == 2);
+
+    // A plain function pointer and a std::function are still accepted
+    assert(logger.apply(&count_vprintf) == 15);
+    std::function<int(char const *, va_list)> const fnCount = &count_vprintf;
+    assert(logger.apply(fnCount) == 15);
+
+    assert(logger.drain(counter) == 15);
+    assert(counter.nCalls == 4);
+    assert(logger.apply(counter) == 0);
+}
+
+void test_native_format()
+{
+    jrmwng::deferred_printf<4000> logger;
+    int nValue = 0;
+    logger("plain text, 100%% literal");
+    logger("[%d] [%i] [%u] [%x] [%X] [%o]", -42, 42, 42u, 255, 255, 8);
+    logger("[%5d] [%-5d] [%05d] [%+d] [% d] [%.3d] [%8.3d] [%-+6d]", 42, 42, -42, 42, 42, 7, -7, 1);
+    logger("[%#x] [%#X] [%#o] [%#o] [%.0d] [%#.0x]", 255, 255, 8, 0, 0, 0);
+    logger("[%u] [%x] [%d] [%hhd] [%hx] [%lld] [%llu] [%zu]", -1, -1, 4294967295u, 300, 70000, -1234567890123LL, 18446744073709551615ULL, size_t(12345));
+    logger("[%c] [%3c] [%-3c]", 'a', 'b', 'c');
+    logger("[%s] [%10s] [%-10s] [%.2s] [%*s] [%-*.*s]", "str", "right", "left", "truncate", 6, "star", 6, 3, "precision");
+    logger("[%f] [%.2f] [%10.3f] [%-10.1f] [%+e] [%g] [%G] [%Lf]", 3.14159, 2.5, -1.0, 0.25, 12345.678, 0.0001, 1e20, 1.5L);
+    logger("[%.3f] [%.2f] [%.0f] [%.0f] [%#.0f] [%010.3f] [% f] [%+.1f] [%f]", 0.0005, 0.125, 2.5, -0.4, 7.0, -3.25, 1.0, -0.04, -0.0); // ties go to snprintf
+    logger("[%f] [%.9f] [%.10f] [%f] [%f]", 1e300, 0.1, 0.1, 1.0 / 0.0, 0.0 / 0.0);
+    logger("[%p] [%p] [%10p]", static_cast<void *>(&nValue), static_cast<void *>(nullptr), static_cast<void *>(&nValue));
+    logger("[%s] [%d]", static_cast<char const *>(nullptr), true);
+
+    std::vector<std::string> expected;
+    logger.apply([&expected](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[256];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        expected.push_back(acBuffer);
+        return nCount;
+    });
+
+    std::vector<std::string> actual;
+    char acBuffer[256];
+    logger.format(acBuffer, sizeof(acBuffer), [&actual](char const *pcText, size_t zuLength) -> int {
+        actual.emplace_back(pcText, zuLength);
+        return static_cast<int>(zuLength);
+    });
+    assert(actual == expected);
+
+    // A log entry longer than the output buffer is truncated, but its full length is still reported
+    jrmwng::deferred_printf<> loggerLong;
+    loggerLong("%s-%d", "abcdefgh", 12345);
+    std::string strTruncated;
+    char acSmall[8];
+    loggerLong.format(acSmall, sizeof(acSmall), [&strTruncated](char const *pcText, size_t zuLength) -> int {
+        strTruncated.assign(pcText, zuLength);
+        return 0;
+    });
+    assert(strTruncated == "abcdefg");
+    jrmwng::details::format_arg const aArgs[] = { jrmwng::details::make_format_arg(12345) };
+    assert(jrmwng::details::format_args(acSmall, sizeof(acSmall), "%d-%d", aArgs, 1) == 8); // the missing argument is echoed
+    assert(std::string(acSmall) == "12345-%");
+}
+
+void test_compile_time_format()
+{
+    auto const format = DEFERRED_PRINTF_FORMAT("[%d] [%-6s] [%#x] [%*d] [%.2f] [%lld] 100%%");
+    using Tplan = jrmwng::details::format_plan<std::decay_t<decltype(format)>>;
+    static_assert(Tplan::zuARGS == 7, "'*' consumes an argument and '%%' consumes none");
+    static_assert(Tplan::matches<int, char const *, unsigned, int, int, double, long long>(std::make_index_sequence<7>()), "The arguments match");
+    static_assert(!Tplan::matches<char const *, char const *, unsigned, int, int, double, long long>(std::make_index_sequence<7>()), "%d does not take a string");
+    static_assert(!Tplan::matches<int, int, unsigned, int, int, double, long long>(std::make_index_sequence<7>()), "%s does not take an int");
+    static_assert(!Tplan::matches<int, char const *, unsigned, int, int, int, long long>(std::make_index_sequence<7>()), "%f does not take an int");
+    static_assert(!Tplan::matches<int, char const *, unsigned, int, int, double, int>(std::make_index_sequence<7>()) || sizeof(int) == sizeof(long long), "%lld does not take an int");
+
+    jrmwng::deferred_printf<> logger;
+    logger(format, 42, "str", 255u, 5, 7, 2.5, 1234567890123LL);
+    logger(DEFERRED_PRINTF_FORMAT("no arguments"));
+
+    std::string strApplied;
+    logger.apply([&strApplied](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[128];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strApplied += acBuffer;
+        strApplied += '\n';
+        return nCount;
+    });
+    assert(strApplied == "[42] [str   ] [0xff] [    7] [2.50] [1234567890123] 100%\nno arguments\n");
+
+    std::string strFormatted;
+    char acBuffer[128];
+    logger.format(acBuffer, sizeof(acBuffer), [&strFormatted](char const *pcText, size_t zuLength) -> int {
+        strFormatted.append(pcText, zuLength);
+        strFormatted += '\n';
+        return static_cast<int>(zuLength);
+    });
+    assert(strFormatted == strApplied);
+}
+
+void test_format_interning()
+{
+    jrmwng::deferred_printf<> logger;
+    for (int i = 0; i < 3; ++i)
+    {
+        logger(DEFERRED_PRINTF_FORMAT("interned %d\n"), i);
+    }
+    logger(DEFERRED_PRINTF_FORMAT("interned %d\n"), 3); // another call site with the same format string
+    logger("interned %d\n", 4); // the same format string, logged at run time
+    logger(DEFERRED_PRINTF_FORMAT("other %s\n"), "str");
+
+    uint32_t const u32Id = jrmwng::details::intern_format("interned %d\n");
+    uint32_t const u32OtherId = jrmwng::details::intern_format("other %s\n");
+    assert(u32Id != u32OtherId);
+    assert(std::string(jrmwng::details::interned_format(u32Id)) == "interned %d\n");
+    assert(u32Id < jrmwng::details::interned_format_count() && u32OtherId < jrmwng::details::interned_format_count());
+
+    std::vector<size_t> const vecCount = logger.count_by_format();
+    assert(vecCount.at(u32Id) == 5);
+    assert(vecCount.at(u32OtherId) == 1);
+}
+
+void test_binary_export()
+{
+    jrmwng::deferred_printf<> logger;
+    char acName[16] = "first";
+    logger("[%s] %d %u %.2f %c\n", acName, -42, 42u, 2.5, 'x');
+    std::strcpy(acName, "second"); // the same buffer, reused before the export
+    logger("[%s] %lld %hd %Lf\n", acName, -1234567890123LL, short(-7), 1.5L);
+    logger("[%s]\n", static_cast<char const *>(nullptr));
+    logger(DEFERRED_PRINTF_FORMAT("planned %x %s\n"), 255u, "str");
+    std::vector<char> vecBytes{ 'a', 'b', 'c', 'd' }; // not null-terminated, so only its address may be read
+    logger("%p [%*s] [%.*s]\n", vecBytes.data(), 6, "pad", 2, "precision");
+
+    std::string strExpected;
+    logger.apply([&strExpected](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[128];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strExpected += acBuffer;
+        return nCount;
+    });
+
+    std::string strBinary;
+    {
+        jrmwng::deferred_printf_binary_writer writer([&strBinary](void const *pv, size_t zuSize) { strBinary.append(static_cast<char const *>(pv), zuSize); });
+        assert(logger.export_binary(writer) == 5);
+        assert(logger.export_binary(writer) == 5); // descriptors and format strings are not repeated
+    }
+
+    size_t zuOffset = 0;
+    jrmwng::deferred_printf_binary_reader reader([&strBinary, &zuOffset](void *pv, size_t zuSize) {
+        size_t const zuRead = (std::min)(zuSize, strBinary.size() - zuOffset);
+        std::memcpy(pv, strBinary.data() + zuOffset, zuRead);
+        zuOffset += zuRead;
+        return zuRead;
+    });
+    std::string strDecoded;
+    std::string strText;
+    int nEntries = 0;
+    while (reader.read(strText))
+    {
+        strDecoded += strText;
+        ++nEntries;
+    }
+    assert(nEntries == 10);
+    assert(strDecoded == strExpected + strExpected);
+
+    // A format buffer reused for another format string between exports is written again
+    std::string strReused;
+    {
+        jrmwng::deferred_printf_binary_writer writer([&strReused](void const *pv, size_t zuSize) { strReused.append(static_cast<char const *>(pv), zuSize); });
+        char acFormat[] = "old %d\n";
+        jrmwng::deferred_printf<> loggerReused;
+        loggerReused(acFormat, 1);
+        loggerReused.export_binary(writer);
+        loggerReused.clear();
+        std::memcpy(acFormat, "new", 3);
+        loggerReused(acFormat, 2);
+        loggerReused.export_binary(writer);
+    }
+    zuOffset = 0;
+    jrmwng::deferred_printf_binary_reader readerReused([&strReused, &zuOffset](void *pv, size_t zuSize) {
+        size_t const zuRead = (std::min)(zuSize, strReused.size() - zuOffset);
+        std::memcpy(pv, strReused.data() + zuOffset, zuRead);
+        zuOffset += zuRead;
+        return zuRead;
+    });
+    strDecoded.clear();
+    while (readerReused.read(strText))
+    {
+        strDecoded += strText;
+    }
+    assert(strDecoded == "old 1\nnew 2\n");
+
+    bool bThrown = false;
+    try
+    {
+        jrmwng::deferred_printf_binary_reader readerInvalid([](void *pv, size_t zuSize) { std::memset(pv, 0, zuSize); return zuSize; });
+    }
+    catch (std::runtime_error const &)
+    {
+        bThrown = true;
+    }
+    assert(bThrown);
+}
+
+void test_copy_string()
+{
+    jrmwng::deferred_printf<> logger;
+    {
+        std::string strTemporary = "temporary";
+        logger("[%s] %d [%s]\n", jrmwng::copy_string(strTemporary.c_str()), 1, jrmwng::copy_string("abcdefghij", 4, "~"));
+        logger(DEFERRED_PRINTF_FORMAT("[%s] %s\n"), jrmwng::copy_string(strTemporary.c_str()), jrmwng::copy_string(nullptr));
+        strTemporary.assign(strTemporary.size(), '#'); // the copies are unaffected by reusing the buffer
+    }
+    logger("%d\n", 2); // walkable past the variable-length log entries
+
+    std::string strApplied;
+    logger.apply([&strApplied](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[128];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strApplied += acBuffer;
+        return nCount;
+    });
+    assert(strApplied == "[temporary] 1 [abcd~]\n[temporary] (null)\n2\n");
+
+    char acBuffer[128];
+    std::string strFormatted;
+    logger.format(acBuffer, sizeof(acBuffer), [&strFormatted](char const *pcText, size_t zuLength) -> int {
+        strFormatted.append(pcText, zuLength);
+        return static_cast<int>(zuLength);
+    });
+    assert(strFormatted == strApplied);
+
+    std::string strBinary;
+    {
+        jrmwng::deferred_printf_binary_writer writer([&strBinary](void const *pv, size_t zuSize) { strBinary.append(static_cast<char const *>(pv), zuSize); });
+        assert(logger.export_binary(writer) == 3);
+    }
+    size_t zuOffset = 0;
+    jrmwng::deferred_printf_binary_reader reader([&strBinary, &zuOffset](void *pv, size_t zuSize) {
+        size_t const zuRead = (std::min)(zuSize, strBinary.size() - zuOffset);
+        std::memcpy(pv, strBinary.data() + zuOffset, zuRead);
+        zuOffset += zuRead;
+        return zuRead;
+    });
+    std::string strDecoded;
+    std::string strText;
+    while (reader.read(strText))
+    {
+        strDecoded += strText;
+    }
+    assert(strDecoded == strApplied);
+
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_drop> loggerSmall;
+    std::string const strLong(100, 'x');
+    loggerSmall("%s", jrmwng::copy_string(strLong.c_str(), 1000)); // never fits
+    assert(loggerSmall.dropped() == 1);
+    loggerSmall("%s", jrmwng::copy_string(strLong.c_str(), 8));
+    assert(loggerSmall.dropped() == 1);
+
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_throw> loggerThrow;
+    bool bThrown = false;
+    try
+    {
+        loggerThrow("%s", jrmwng::copy_string(strLong.c_str(), 1000)); // never fits, and throws like any other entry that does not fit
+    }
+    catch (std::bad_alloc const &)
+    {
+        bThrown = true;
+    }
+    assert(bThrown && loggerThrow.dropped() == 0);
+
+    std::unique_ptr<char[]> const pcUnterminated(new char[6]); // exactly sized, so reading past it trips the address sanitizer
+    std::memcpy(pcUnterminated.get(), "abcdef", 6);
+    jrmwng::deferred_printf<> loggerView;
+    loggerView("[%s] [%s] [%s] [%s] [%s] [%s]\n",
+        jrmwng::copy_string(std::string_view(pcUnterminated.get(), 6), 6),
+        jrmwng::copy_string(std::string_view(pcUnterminated.get(), 6), 4, "~"),
+        jrmwng::copy_string(std::string_view(pcUnterminated.get(), 3)),
+        jrmwng::copy_string(std::string("text")),
+        jrmwng::copy_string(std::string_view(pcUnterminated.get(), 6), 2, nullptr), // truncated without a marker
+        jrmwng::copy_string("abcdef", 3, nullptr));
+    std::string strView;
+    loggerView.apply([&strView](char const *pcFormat, va_list vaArgs) -> int {
+        char acText[128];
+        int const nCount = vsnprintf(acText, sizeof(acText), pcFormat, vaArgs);
+        strView += acText;
+        return nCount;
+    });
+    assert(strView == "[abcdef] [abcd~] [abc] [text] [ab] [abc]\n");
+}
+
+void test_timestamps()
+{
+    jrmwng::details::deferred_printf_logger<4000, false, jrmwng::overflow_throw, jrmwng::clock_monotonic> loggerMonotonic;
+    loggerMonotonic.log("first %d\n", 1);
+    loggerMonotonic.log("second %s\n", jrmwng::copy_string("copied"));
+    std::vector<uint64_t> vecTimestamps;
+    for (jrmwng::details::deferred_printf_log_header const &iLog : loggerMonotonic)
+    {
+        uint64_t u64Timestamp;
+        assert(iLog.timestamp(u64Timestamp));
+        vecTimestamps.push_back(u64Timestamp);
+    }
+    assert(vecTimestamps.size() == 2 && vecTimestamps[0] <= vecTimestamps[1]);
+
+    jrmwng::details::deferred_printf_logger<> loggerNone;
+    loggerNone.log("none\n");
+    for (jrmwng::details::deferred_printf_log_header const &iLog : loggerNone)
+    {
+        uint64_t u64Timestamp;
+        assert(!iLog.timestamp(u64Timestamp));
+        assert(iLog.size() == sizeof(jrmwng::details::Cdeferred_printf_log<char const *>));
+    }
+
+    jrmwng::clock_calibration const calibration = jrmwng::clock_calibration::calibrate<jrmwng::clock_tsc>();
+    jrmwng::deferred_printf<4000, false, jrmwng::overflow_throw, jrmwng::clock_tsc> logger;
+    logger("tsc %d\n", 42);
+    std::string strApplied;
+    logger.apply([&strApplied](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[128];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strApplied += acBuffer;
+        return nCount;
+    }, calibration);
+    long long llSeconds = 0;
+    long long llNanoseconds = 0;
+    char acText[16] = "";
+    assert(std::sscanf(strApplied.c_str(), "[%lld.%lld] %15[^\n]", &llSeconds, &llNanoseconds, acText) == 3);
+    assert(std::string(acText) == "tsc 42");
+    long long const llNow = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    assert(llSeconds <= llNow && llNow - llSeconds <= 5);
+
+    // One callback call per log entry, so a callback writing into a fixed buffer keeps the prefix
+    std::string const strLongFormat = std::string(300, '-') + " %d\n"; // longer than the stack buffer of the prefix
+    jrmwng::deferred_printf<4000, false, jrmwng::overflow_throw, jrmwng::clock_tsc> loggerLong;
+    loggerLong(strLongFormat.c_str(), 7);
+    for (jrmwng::deferred_printf<4000, false, jrmwng::overflow_throw, jrmwng::clock_tsc> const *pLogger : { &logger, &loggerLong })
+    {
+        char acLine[512] = "";
+        int nCalls = 0;
+        pLogger->apply([&acLine, &nCalls](char const *pcFormat, va_list vaArgs) -> int {
+            ++nCalls;
+            return vsnprintf(acLine, sizeof(acLine), pcFormat, vaArgs);
+        }, calibration);
+        char const *const pcMessage = std::strstr(acLine, "] ");
+        assert(nCalls == 1 && acLine[0] == '[' && pcMessage);
+        assert(std::strcmp(pcMessage + 2, pLogger == &logger ? "tsc 42\n" : (std::string(300, '-') + " 7\n").c_str()) == 0);
+    }
+}
+
+/**
+ * @brief Clock policy that counts log entries, so that the tests get distinct and predictable timestamps.
+ */
+struct clock_counter
+{
+    constexpr static bool bENABLED = true;
+    constexpr static bool bNANOSECONDS = true;
+
+    static uint64_t now() noexcept
+    {
+        static std::atomic<uint64_t> s_u64Ticks(0);
+        return ++s_u64Ticks;
+    }
+};
+
+void test_merge()
+{
+    jrmwng::deferred_printf<4000, false, jrmwng::overflow_throw, clock_counter> loggerA;
+    jrmwng::deferred_printf<4000, true, jrmwng::overflow_drop, clock_counter> loggerB;
+    jrmwng::deferred_printf<4000, false, jrmwng::overflow_throw, clock_counter> loggerEmpty;
+    loggerA("a%d ", 1);
+    loggerB("b%d ", 1);
+    loggerB("b%d ", 2);
+    loggerA("a%d ", 2);
+    loggerB("b%s ", jrmwng::copy_string("3"));
+    loggerA("a%d ", 3);
+
+    std::string strMerged;
+    auto const fnAppend = [&strMerged](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[64];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strMerged += acBuffer;
+        return nCount;
+    };
+    assert(jrmwng::merge_apply(fnAppend, loggerA, loggerEmpty, loggerB) == 18);
+    assert(strMerged == "a1 b1 b2 a2 b3 a3 ");
+
+    strMerged.clear();
+    jrmwng::deferred_printf_merge merge;
+    merge.add(loggerB.begin(), loggerB.end());
+    merge.add(loggerA);
+    merge.apply(fnAppend);
+    assert(strMerged == "a1 b1 b2 a2 b3 a3 ");
+    assert(merge.apply(fnAppend) == 0); // replayed entries are forgotten
+}
+
+void test_registry()
+{
+    using registry_t = jrmwng::deferred_printf_registry<>;
+    registry_t &registry = registry_t::instance();
+    auto const fnCount = [](char const *pcFormat, va_list vaArgs) -> int {
+        return vsnprintf(nullptr, 0, pcFormat, vaArgs) > 0 ? 1 : 0;
+    };
+
+    jrmwng::tlog("main %d\n", 0);
+    std::vector<std::thread> vecThreads;
+    for (int nThread = 0; nThread < 4; ++nThread)
+    {
+        vecThreads.emplace_back([nThread]() {
+            for (int i = 0; i < 100; ++i)
+            {
+                jrmwng::tlog(DEFERRED_PRINTF_FORMAT("thread %d: %d\n"), nThread, i);
+            }
+        });
+    }
+    for (std::thread &thread : vecThreads)
+    {
+        thread.join();
+    }
+    assert(registry.size() == 5);
+    assert(&registry_t::local() == &registry_t::local());
+
+    assert(registry.collect(fnCount) == 401);
+    assert(registry.size() == 1); // the loggers of the exited threads are released
+    assert(registry.dropped() == 0);
+    assert(registry.collect(fnCount) == 0);
+
+    // The drops of a released logger are still reported
+    std::thread threadFlood([]() {
+        for (int i = 0; i < 1000; ++i)
+        {
+            jrmwng::tlog(DEFERRED_PRINTF_FORMAT("flood %d\n"), i);
+        }
+    });
+    threadFlood.join();
+    size_t const zuDropped = registry.dropped();
+    assert(zuDropped > 0);
+    registry.collect(fnCount);
+    assert(registry.size() == 1 && registry.dropped() == zuDropped);
+}
+
+void test_severity()
+{
+    jrmwng::deferred_printf<> logger;
+    logger.trace("trace %d\n", 0);
+    logger.debug("debug %d\n", 1);
+    logger("plain\n");
+    logger.info(DEFERRED_PRINTF_FORMAT("info %s\n"), "planned");
+    jrmwng::set_severity_threshold(jrmwng::severity::warn);
+    logger.info("filtered at runtime\n");
+    logger.warn("warn %d\n", 3);
+    logger.error("error %s\n", jrmwng::copy_string("copied"));
+    assert(jrmwng::severity_threshold() == jrmwng::severity::warn);
+    jrmwng::set_severity_threshold(jrmwng::severity::trace);
+
+    std::vector<int> vecLevels;
+    for (jrmwng::details::deferred_printf_log_header const &iLog : logger)
+    {
+        jrmwng::severity eSeverity;
+        vecLevels.push_back(iLog.level(eSeverity) ? static_cast<int>(eSeverity) : -1);
+    }
+    assert((vecLevels == std::vector<int>{ 0, 1, -1, 2, 3, 4 }));
+
+    std::string strApplied;
+    logger.apply([&strApplied](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[64];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strApplied += acBuffer;
+        return nCount;
+    }, jrmwng::severity::info);
+    assert(strApplied == "info planned\nwarn 3\nerror copied\n");
+
+    // The macro form does not evaluate the arguments of a skipped level
+    int nEvaluated = 0;
+    auto const evaluate = [&nEvaluated]() { return ++nEvaluated; };
+    jrmwng::deferred_printf<> loggerMacro;
+    jrmwng::set_severity_threshold(jrmwng::severity::info);
+    DEFERRED_PRINTF_LOG(loggerMacro, debug, "debug %d\n", evaluate());
+    DEFERRED_PRINTF_LOG(loggerMacro, warn, DEFERRED_PRINTF_FORMAT("warn %d\n"), evaluate());
+    loggerMacro.debug("debug %d\n", evaluate()); // skipped, but its argument is evaluated
+    jrmwng::set_severity_threshold(jrmwng::severity::trace);
+    assert(nEvaluated == 2 && loggerMacro.stats().zuEntriesHeld == 1);
+}
+
+void test_filtered_apply()
+{
+    jrmwng::deferred_printf<> logger;
+    for (int i = 0; i < 10; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            logger.error("e%d ", i);
+        }
+        else
+        {
+            logger(DEFERRED_PRINTF_FORMAT("p%d "), i);
+        }
+    }
+
+    std::string strApplied;
+    auto const fnAppend = [&strApplied](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[64];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strApplied += acBuffer;
+        return nCount;
+    };
+    assert(logger.apply(fnAppend, logger.tail(3), logger.end()) == 9);
+    assert(strApplied == "p7 p8 e9 ");
+
+    strApplied.clear();
+    assert(!(logger.tail(100) != logger.begin()));
+    logger.apply(fnAppend, logger.tail(0), logger.end());
+    assert(strApplied.empty());
+
+    uint32_t const u32Planned = (*logger.tail(2)).format_id();
+    logger.apply(fnAppend, [u32Planned](jrmwng::details::deferred_printf_log_header const &iLog) { return iLog.format_id() == u32Planned; });
+    assert(strApplied == "p1 p2 p4 p5 p7 p8 ");
+
+    strApplied.clear();
+    logger.apply(fnAppend, logger.begin(), logger.tail(5), [](jrmwng::details::deferred_printf_log_header const &iLog) {
+        jrmwng::severity eSeverity;
+        return iLog.level(eSeverity) && eSeverity == jrmwng::severity::error;
+    });
+    assert(strApplied == "e0 e3 ");
+}
+
+void test_runtime_format_id()
+{
+    jrmwng::deferred_printf<> logger;
+    uint32_t u32Id;
+    {
+        std::string strFormat("runtime %d");
+        logger(strFormat.c_str(), 1);
+        u32Id = (*logger.begin()).format_id();
+        logger.clear();
+    } // the registry must not keep a view of the freed format string
+
+    std::string strOther(std::string("runtime") + " %d");
+    logger(strOther.c_str(), 2);
+    assert((*logger.begin()).format_id() == u32Id);
+    assert(std::strcmp(jrmwng::details::interned_format(u32Id), "runtime %d") == 0);
+    assert(jrmwng::details::interned_format(u32Id) != strOther.c_str());
+
+    // A buffer reused for another format string gets the ID of its new contents, not a cached one
+    char acFormat[] = "reused %d";
+    logger.clear();
+    logger(acFormat, 3);
+    uint32_t const u32Reused = (*logger.begin()).format_id();
+    assert((*logger.begin()).format_id() == u32Reused);
+    std::memcpy(acFormat, "REUSED", 6);
+    assert((*logger.begin()).format_id() != u32Reused);
+    assert(std::strcmp(jrmwng::details::interned_format((*logger.begin()).format_id()), "REUSED %d") == 0);
+}
+
+void test_apply_checked()
+{
+    jrmwng::deferred_printf<> logger;
+    for (int i = 0; i < 6; ++i)
+    {
+        logger("entry %d\n", i);
+    }
+
+    int nCalls = 0;
+    auto const fnFailThird = [&nCalls](char const *pcFormat, va_list vaArgs) -> int {
+        if (++nCalls == 3)
+        {
+            errno = ENOSPC;
+            return -1;
+        }
+        return vsnprintf(nullptr, 0, pcFormat, vaArgs);
+    };
+
+    jrmwng::apply_result const resultAbort = logger.apply_checked(fnFailThird);
+    assert(!resultAbort);
+    assert(nCalls == 3); // nothing is formatted after the failure
+    assert(resultAbort.zuEntries == 2 && resultAbort.zuBytes == 16);
+    assert(resultAbort.zuFailed == 2 && resultAbort.nErrno == ENOSPC);
+
+    nCalls = 0;
+    jrmwng::apply_result const resultRetry = logger.apply_checked(fnFailThird, jrmwng::failure_retry{ 2 });
+    assert(resultRetry && nCalls == 7);
+    assert(resultRetry.zuEntries == 6 && resultRetry.zuBytes == 48);
+
+    nCalls = 0;
+    jrmwng::apply_result const resultSkip = logger.apply_checked(fnFailThird, jrmwng::failure_skip());
+    assert(!resultSkip && nCalls == 6);
+    assert(resultSkip.zuEntries == 5 && resultSkip.zuFailed == 2);
+
+    nCalls = 0;
+    assert(logger.apply(fnFailThird) == 40); // the legacy overload skips failures
+}
+
+void test_fd_sink()
+{
+    jrmwng::deferred_printf<> logger;
+    std::string strExpected;
+    for (int i = 0; i < 20; ++i)
+    {
+        logger("entry %d\n", i);
+        strExpected += "entry " + std::to_string(i) + "\n";
+    }
+    std::string const strLong(100, 'x'); // larger than the flush threshold
+    logger("%s\n", strLong.c_str());
+    strExpected += strLong + "\n";
+
+    std::FILE *pFile = std::tmpfile();
+    assert(pFile != nullptr);
+    {
+        jrmwng::deferred_printf_fd_sink sink(fileno(pFile), 32);
+        assert(logger.apply(sink) == static_cast<int>(strExpected.size()));
+        jrmwng::apply_result const result = sink.write_all(logger);
+        assert(result && result.zuEntries == 21 && result.zuBytes == strExpected.size());
+        char acBuffer[64];
+        logger.format(acBuffer, sizeof(acBuffer), sink); // the long entry is truncated to the buffer
+        assert(sink.flush() && sink.error() == 0);
+    }
+    std::string strWritten(4 * strExpected.size(), '\0');
+    std::rewind(pFile);
+    strWritten.resize(std::fread(&strWritten[0], 1, strWritten.size(), pFile));
+    std::fclose(pFile);
+    std::string const strTruncated = strExpected.substr(0, strExpected.size() - strLong.size() - 1) + strLong.substr(0, 63);
+    assert(strWritten == strExpected + strExpected + strTruncated);
+
+    jrmwng::deferred_printf_fd_sink sinkClosed(-1, 32);
+    jrmwng::apply_result const result = logger.apply_checked(sinkClosed);
+    assert(!result && result.zuFailed == 4 && sinkClosed.error() == EBADF); // the fifth entry no longer fits the first batch
+}
+
+void test_stats()
+{
+    jrmwng::deferred_printf<256, false, jrmwng::overflow_drop> logger;
+    size_t const zuSMALL = sizeof(jrmwng::details::Cdeferred_printf_log<char const *>);
+    size_t const zuLARGE = sizeof(jrmwng::details::Cdeferred_printf_log<char const *, long long, long long>);
+    logger("small\n");
+    logger("small\n");
+    logger("large %lld %lld\n", 1LL, 2LL);
+
+    jrmwng::deferred_printf_stats const stats = logger.stats();
+    assert(stats.zuCapacity == 256);
+    assert(stats.zuEntriesHeld == 3);
+    assert(stats.zuBytesHeld == 2 * zuSMALL + zuLARGE);
+    assert(stats.zuHighWater == stats.zuBytesHeld);
+    assert(stats.zuDropped == 0);
+    assert(stats.azuSizeHistogram[jrmwng::deferred_printf_stats::size_class(zuSMALL)] == 2);
+    assert(stats.azuSizeHistogram[jrmwng::deferred_printf_stats::size_class(zuLARGE)] == 1);
+    assert(jrmwng::deferred_printf_stats::size_class(8) == 0 && jrmwng::deferred_printf_stats::size_class(16) == 1 && jrmwng::deferred_printf_stats::size_class(65535) == 12);
+    assert(stats.vecBytesByFormat[jrmwng::details::intern_format("small\n")] == 2 * zuSMALL);
+    assert(stats.vecBytesByFormat[jrmwng::details::intern_format("large %lld %lld\n")] == zuLARGE);
+
+    logger.drain([](char const *, va_list) { return 0; });
+    for (int i = 0; i < 100; ++i)
+    {
+        logger("small\n");
+    }
+    jrmwng::deferred_printf_stats const statsFull = logger.stats();
+    assert(statsFull.zuEntriesHeld == 256 / zuSMALL);
+    assert(statsFull.zuDropped == 100 - statsFull.zuEntriesHeld);
+    assert(statsFull.zuHighWater == statsFull.zuBytesHeld);
+    logger.drain([](char const *, va_list) { return 0; });
+    assert(logger.stats().zuHighWater == statsFull.zuBytesHeld); // kept across drains
+    assert(logger.stats().zuEntriesHeld == 0);
+
+    // The bytes that the ring buffer discarded count towards the high-water mark, which is kept as log entries are logged
+    jrmwng::deferred_printf<256, false, jrmwng::overflow_overwrite> ring;
+    for (int i = 0; i < 100; ++i)
+    {
+        ring("small\n");
+    }
+    jrmwng::deferred_printf_stats const statsRing = ring.stats();
+    assert(statsRing.zuBytesHeld <= 256 && statsRing.zuHighWater == 100 * zuSMALL);
+
+    jrmwng::deferred_printf<4000, true> concurrent;
+    concurrent("small\n");
+    concurrent("small\n");
+    assert(concurrent.stats().zuHighWater == 2 * zuSMALL);
+}
+
+void test_clear()
+{
+    jrmwng::deferred_printf<1 << 16> logger; // std::vector storage
+    logger("first %d\n", 1);
+    jrmwng::details::deferred_printf_log_header const *pFirst = &*logger.begin();
+    logger.clear();
+    assert(!(logger.begin() != logger.end()));
+    assert(logger.apply([](char const *, va_list) { return 1; }) == 0);
+
+    logger("second %d\n", 2);
+    assert(&*logger.begin() == pFirst); // the same buffer is reused
+    std::string strApplied;
+    logger.drain([&strApplied](char const *pcFormat, va_list vaArgs) -> int {
+        char acBuffer[64];
+        int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+        strApplied += acBuffer;
+        return nCount;
+    });
+    assert(strApplied == "second 2\n");
+    assert(!(logger.begin() != logger.end()));
+
+    jrmwng::deferred_printf<4000, true> loggerConcurrent;
+    loggerConcurrent("concurrent\n");
+    loggerConcurrent.clear();
+    loggerConcurrent("again\n");
+    assert(loggerConcurrent.stats().zuEntriesHeld == 1);
+
+    // clear() waits for a drain in progress on another thread instead of returning without doing anything
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+    std::thread threadDrain([&] {
+        loggerConcurrent.drain([&](char const *, va_list) -> int {
+            bStarted.store(true);
+            while (!bReleased.load())
+            {
+                std::this_thread::yield();
+            }
+            return 1;
+        });
+    });
+    while (!bStarted.load())
+    {
+        std::this_thread::yield();
+    }
+    std::thread threadRelease([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        bReleased.store(true);
+    });
+    loggerConcurrent.clear();
+    assert(bReleased.load());
+    threadDrain.join();
+    threadRelease.join();
+    loggerConcurrent("after\n");
+    assert(loggerConcurrent.stats().zuEntriesHeld == 1);
+}
+
+void test_move_and_detach()
+{
+    auto const collect = [](auto const &logger) {
+        std::string str;
+        logger.apply([&str](char const *pcFormat, va_list vaArgs) -> int {
+            char acBuffer[64];
+            int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+            str += acBuffer;
+            return nCount;
+        });
+        return str;
+    };
+    static_assert(!std::is_copy_constructible_v<jrmwng::deferred_printf<>>, "Copying a logger is explicit only");
+
+    // A buffer on the heap changes hands without copying
+    using heap_logger_t = jrmwng::deferred_printf<1 << 16>;
+    heap_logger_t a;
+    heap_logger_t b;
+    a("a%d ", 1);
+    b("b%d ", 2);
+    jrmwng::details::deferred_printf_log_header const *pA = &*a.begin();
+    swap(a, b);
+    assert(collect(a) == "b2 " && collect(b) == "a1 ");
+    assert(&*b.begin() == pA);
+    a = std::move(b);
+    assert(&*a.begin() == pA);
+    assert(collect(a) == "a1 " && collect(b).empty());
+    b("b%d ", 3); // the moved-from object is still usable
+    assert(collect(b) == "b3 ");
+
+    heap_logger_t::log_batch batch;
+    a.detach(batch);
+    assert(&*batch.begin() == pA);
+    assert(!(a.begin() != a.end()));
+    a("a%d ", 4);
+    a.detach(batch); // the spent batch is recycled
+    assert(collect(batch) == "a4 ");
+
+    // The batch is replayed on another thread while the logger keeps logging
+    heap_logger_t::log_batch batchMoved = b.detach();
+    std::string strReplayed;
+    std::thread thread([&]() { strReplayed = collect(batchMoved); });
+    b("b%d ", 5);
+    thread.join();
+    assert(strReplayed == "b3 " && collect(b) == "b5 ");
+
+    // An inline buffer, a concurrent one, a ring buffer and a list of pages
+    jrmwng::deferred_printf<> c;
+    jrmwng::deferred_printf<> d;
+    c("c%s ", jrmwng::copy_string("1"));
+    d("d%d ", 2);
+    d("d%d ", 3);
+    c.swap(d);
+    assert(collect(c) == "d2 d3 " && collect(d) == "c1 ");
+
+    jrmwng::deferred_printf<64, true, jrmwng::overflow_drop> e;
+    jrmwng::deferred_printf<64, true, jrmwng::overflow_drop> f;
+    for (int i = 0; i < 10; ++i)
+    {
+        e("e%d ", i); // drops the log entries that do not fit
+    }
+    std::string const strE = collect(e);
+    f("f%d ", 1);
+    e.swap(f);
+    assert(collect(e) == "f1 " && collect(f) == strE);
+    e("e%d ", 2); // the bytes after the log entries are still zero
+    assert(collect(e) == "f1 e2 ");
+
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_overwrite> ring;
+    for (int i = 0; i < 20; ++i)
+    {
+        ring("r%d ", i);
+    }
+    std::string const strRing = collect(ring);
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_overwrite> ringMoved(std::move(ring));
+    assert(collect(ringMoved) == strRing && collect(ring).empty());
+
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_grow> grow;
+    for (int i = 0; i < 20; ++i)
+    {
+        grow("g%d ", i);
+    }
+    std::string const strGrow = collect(grow);
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_grow>::log_batch batchGrow = grow.detach();
+    assert(collect(batchGrow) == strGrow && collect(grow).empty());
+    grow("g%d ", 20);
+    assert(collect(grow) == "g20 ");
+
+    // Producers racing to log first into a concurrent logger left without a buffer allocate it once
+    using concurrent_logger_t = jrmwng::deferred_printf<1 << 16, true, jrmwng::overflow_block>;
+    concurrent_logger_t concurrent;
+    concurrent("before\n");
+    concurrent_logger_t::log_batch batchConcurrent = concurrent.detach();
+    std::vector<std::thread> vecProducers;
+    for (int nThread = 0; nThread < 4; ++nThread)
+    {
+        vecProducers.emplace_back([&concurrent, nThread]() {
+            for (int i = 0; i < 100; ++i)
+            {
+                concurrent("t%d i%d\n", nThread, i);
+            }
+        });
+    }
+    for (std::thread &thread : vecProducers)
+    {
+        thread.join();
+    }
+    assert(concurrent.stats().zuEntriesHeld == 400 && batchConcurrent.stats().zuEntriesHeld == 1);
+
+    // Producers wait for the allocation instead of dropping the burst that follows a detach
+    using dropping_logger_t = jrmwng::deferred_printf<1 << 22, true, jrmwng::overflow_drop>;
+    dropping_logger_t dropping;
+    dropping("before\n");
+    dropping_logger_t::log_batch batchDropping = dropping.detach();
+    std::vector<std::thread> vecBurst;
+    for (int nThread = 0; nThread < 8; ++nThread)
+    {
+        vecBurst.emplace_back([&dropping, nThread]() {
+            for (int i = 0; i < 500; ++i)
+            {
+                dropping("t%d i%d\n", nThread, i);
+            }
+        });
+    }
+    for (std::thread &thread : vecBurst)
+    {
+        thread.join();
+    }
+    assert(dropping.dropped() == 0 && dropping.stats().zuEntriesHeld == 4000);
+
+    static_assert(noexcept(std::declval<heap_logger_t &>().swap(std::declval<heap_logger_t &>())), "Equal allocators never allocate to swap");
+    static_assert(!noexcept(std::declval<jrmwng::pmr::deferred_printf<1 << 16> &>().swap(std::declval<jrmwng::pmr::deferred_printf<1 << 16> &>())), "Unequal memory resources may allocate to swap");
+}
+
+/**
+ * @brief Memory resource that fills its allocations with garbage and counts them.
+ */
+struct garbage_resource : std::pmr::memory_resource
+{
+    size_t zuAllocations = 0;
+
+    void *do_allocate(size_t zuBytes, size_t zuAlignment) override
+    {
+        ++zuAllocations;
+        void *pv = std::pmr::new_delete_resource()->allocate(zuBytes, zuAlignment);
+        std::memset(pv, 0xAB, zuBytes);
+        return pv;
+    }
+
+    void do_deallocate(void *pv, size_t zuBytes, size_t zuAlignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(pv, zuBytes, zuAlignment);
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+void test_allocator()
+{
+    auto const collect = [](auto const &logger) {
+        std::string str;
+        logger.apply([&str](char const *pcFormat, va_list vaArgs) -> int {
+            char acBuffer[64];
+            int const nCount = vsnprintf(acBuffer, sizeof(acBuffer), pcFormat, vaArgs);
+            str += acBuffer;
+            return nCount;
+        });
+        return str;
+    };
+
+    garbage_resource resource;
+    garbage_resource resourceOther;
+
+    // The buffer is not zeroed, which a single-producer logger never needs
+    jrmwng::pmr::deferred_printf<1 << 16> a(&resource);
+    assert(resource.zuAllocations == 1);
+    assert(a.get_allocator().resource() == &resource);
+    a("a%d ", 1);
+    a("a%s ", jrmwng::copy_string("2"));
+    assert(collect(a) == "a1 a2 ");
+
+    // A concurrent logger zeroes its buffer itself
+    jrmwng::pmr::deferred_printf<1 << 16, true> c(&resource);
+    c("c%d ", 1);
+    assert(collect(c) == "c1 ");
+
+    // The same resource exchanges the buffers; different ones exchange the log entries
+    jrmwng::pmr::deferred_printf<1 << 16> b(&resource);
+    b("b%d ", 1);
+    jrmwng::details::deferred_printf_log_header const *pB = &*b.begin();
+    a.swap(b);
+    assert(&*a.begin() == pB);
+    assert(collect(a) == "b1 " && collect(b) == "a1 a2 ");
+
+    jrmwng::pmr::deferred_printf<1 << 16> d(&resourceOther);
+    d("d%d ", 1);
+    d.swap(a);
+    assert(d.get_allocator().resource() == &resourceOther && a.get_allocator().resource() == &resource);
+    assert(collect(a) == "d1 " && collect(d) == "b1 ");
+    jrmwng::pmr::deferred_printf<1 << 16> dMoved(std::move(d));
+    assert(dMoved.get_allocator().resource() == &resourceOther);
+    assert(collect(dMoved) == "b1 " && collect(d).empty());
+
+    // The default allocator does not zero either, and an inline buffer ignores the allocator
+    jrmwng::deferred_printf<1 << 16> e(std::allocator<char>{});
+    e("e%d ", 1);
+    assert(collect(e) == "e1 ");
+    jrmwng::pmr::deferred_printf<> f(&resource);
+    size_t const zuAllocations = resource.zuAllocations;
+    f("f%d ", 1);
+    assert(collect(f) == "f1 " && resource.zuAllocations == zuAllocations);
+
+    // Moving or detaching leaves the other object without a buffer, which it allocates on its next log entry
+    jrmwng::pmr::deferred_printf<1 << 16> g(&resource);
+    g("g%d ", 1);
+    size_t const zuBeforeDetach = resource.zuAllocations;
+    jrmwng::pmr::deferred_printf<1 << 16>::log_batch batchG = g.detach();
+    assert(resource.zuAllocations == zuBeforeDetach);
+    assert(!(g.begin() != g.end()) && g.stats().zuEntriesHeld == 0);
+    g("g%d ", 2);
+    assert(resource.zuAllocations == zuBeforeDetach + 1);
+    assert(collect(g) == "g2 " && collect(batchG) == "g1 ");
+
+    jrmwng::pmr::deferred_printf<1 << 16, true> h(&resource);
+    h("h%d ", 1);
+    size_t const zuBeforeMove = resource.zuAllocations;
+    jrmwng::pmr::deferred_printf<1 << 16, true> hMoved(std::move(h));
+    h.clear();
+    assert(resource.zuAllocations == zuBeforeMove && !(h.begin() != h.end()));
+    h("h%d ", 2); // the new buffer of a concurrent logger is zeroed
+    assert(resource.zuAllocations == zuBeforeMove + 1);
+    assert(collect(h) == "h2 " && collect(hMoved) == "h1 ");
+
+    jrmwng::pmr::deferred_printf<1 << 16, true, jrmwng::overflow_drop> k(&resource);
+    jrmwng::pmr::deferred_printf<1 << 16, true, jrmwng::overflow_drop> kMoved(std::move(k));
+    size_t const zuBeforeClose = resource.zuAllocations;
+    assert(k.drain_and_close([](char const *, va_list) { return 1; }) == 0);
+    k("k%d ", 1); // closed, so dropped without allocating
+    assert(k.dropped() == 1 && resource.zuAllocations == zuBeforeClose);
+    k.reopen();
+    k("k%d ", 2);
+    assert(collect(k) == "k2 " && resource.zuAllocations == zuBeforeClose + 1);
+
+    jrmwng::pmr::deferred_printf<1 << 16> m(&resourceOther);
+    m("m%d ", 1);
+    jrmwng::pmr::deferred_printf<1 << 16> mMoved(std::move(m));
+    m.swap(g); // different resources, so the buffer that m lacks is allocated to exchange the log entries
+    assert(collect(m) == "g2 " && collect(g).empty());
+}
+
+void test_drainer()
+{
+    std::vector<std::string> output;
+    std::thread::id idConsumer;
+    {
+        jrmwng::deferred_printf_drainer<256> drainer([&](char const *pcFormat, va_list args) -> int {
+            char buffer[256];
+            int const nCount = vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+            output.push_back(buffer);
+            idConsumer = std::this_thread::get_id();
+            return nCount;
+        });
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            drainer("Drained %d", i);
+        }
+        drainer.flush();
+        assert(output.size() == 1000);
+
+        drainer("Last %s", "entry");
+    }
+
+    assert(idConsumer != std::this_thread::get_id());
+    assert(output.size() == 1001);
+    for (int i = 0; i < 1000; ++i)
+    {
+        assert(output[i] == "Drained " + std::to_string(i));
+    }
+    assert(output[1000] == "Last entry");
+
+    // Producers log without a lock; each one's log entries still come out in order, and none is lost
+    std::vector<int> vecNext(4, 0);
+    size_t zuDropped = 0;
+    {
+        jrmwng::deferred_printf_drainer<256> drainer([&](char const *, va_list args) -> int {
+            int const nThread = va_arg(args, int);
+            int const nIndex = va_arg(args, int);
+            assert(vecNext[nThread] == nIndex);
+            vecNext[nThread] = nIndex + 1;
+            return 0;
+        });
+        std::vector<std::thread> vecThreads;
+        for (int nThread = 0; nThread < 4; ++nThread)
+        {
+            vecThreads.emplace_back([&drainer, nThread]() {
+                for (int i = 0; i < 10000; ++i)
+                {
+                    drainer("%d %d", nThread, i);
+                }
+            });
+        }
+        for (std::thread &thread : vecThreads)
+        {
+            thread.join();
+        }
+        std::string const strLong(400, 'x');
+        drainer("%s", jrmwng::copy_string(strLong.c_str(), 300)); // larger than a buffer
+        zuDropped = drainer.dropped();
+    }
+    assert(vecNext == std::vector<int>(4, 10000));
+    assert(zuDropped == 1);
+}
+
+void test_ring_buffer()
+{
+    jrmwng::deferred_printf<256, false, jrmwng::overflow_overwrite> logger;
+    static_assert(noexcept(logger("Entry %d", 0)), "The ring buffer never throws");
+
+    for (int i = 0; i < 100; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            logger("Entry %d %s %f", i, "long", 1.5); // larger log entries move the wrap point around
+        }
+        else
+        {
+            logger("Entry %d", i);
+        }
+    }
+
+    std::vector<int> output;
+    logger.apply([&output](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        int i = -1;
+        sscanf(buffer, "Entry %d", &i);
+        output.push_back(i);
+        return 0;
+    });
+
+    // the newest log entries survive, oldest first
+    assert(!output.empty());
+    assert(output.back() == 99);
+    for (size_t i = 1; i < output.size(); ++i)
+    {
+        assert(output[i] == output[i - 1] + 1);
+    }
+}
+
+void test_ring_buffer_without_wrap()
+{
+    jrmwng::deferred_printf<4000, false, jrmwng::overflow_overwrite> logger;
+
+    logger("Hello %d %d", 1, 2);
+    logger("Test %s", "string");
+
+    std::vector<std::string> output;
+    logger.apply([&output](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        output.push_back(buffer);
+        return 0;
+    });
+
+    assert(output.size() == 2);
+    assert(output[0] == "Hello 1 2");
+    assert(output[1] == "Test string");
+}
+
+void test_overflow_drop()
+{
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_drop> logger;
+    static_assert(noexcept(logger("Entry %d", 0)), "Dropping never throws");
+
+    for (int i = 0; i < 10; ++i)
+    {
+        logger("Entry %d", i);
+    }
+
+    std::vector<std::string> output;
+    logger.apply([&output](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        output.push_back(buffer);
+        return 0;
+    });
+
+    assert(!output.empty());
+    assert(output[0] == "Entry 0");
+    assert(output.size() + logger.dropped() == 10);
+}
+
+void test_overflow_flush()
+{
+    static std::vector<std::string> output;
+    output.clear();
+    auto collect = [](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        int const nCount = vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        output.push_back(buffer);
+        return nCount;
+    };
+
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_flush> logger(jrmwng::overflow_flush{ collect });
+    static_assert(noexcept(logger("Entry %d", 0)), "Flushing never throws");
+
+    for (int i = 0; i < 100; ++i)
+    {
+        logger("Entry %d", i);
+    }
+    assert(!output.empty() && output.size() < 100); // flushed on overflow
+    logger.drain(collect);
+
+    assert(output.size() == 100);
+    for (int i = 0; i < 100; ++i)
+    {
+        assert(output[i] == "Entry " + std::to_string(i));
+    }
+    assert(logger.dropped() == 0);
+}
+
+void test_overflow_grow()
+{
+    jrmwng::deferred_printf<64, false, jrmwng::overflow_grow> logger;
+    static_assert(noexcept(logger("Entry %d", 0)), "Growing never throws");
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        logger("Entry %d", i);
+    }
+    logger("Large %f %f %f %f %f %f %f %f %f", 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0); // larger than a chunk
+
+    std::vector<std::string> output;
+    logger.apply([&output](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        output.push_back(buffer);
+        return 0;
+    });
+
+    assert(output.size() == 1001);
+    for (int i = 0; i < 1000; ++i)
+    {
+        assert(output[i] == "Entry " + std::to_string(i));
+    }
+    assert(output[1000] == "Large 1.000000 2.000000 3.000000 4.000000 5.000000 6.000000 7.000000 8.000000 9.000000");
+    assert(logger.dropped() == 0);
+}
+
+void test_overflow_block()
+{
+    constexpr int nTHREADS = 4;
+    constexpr int nENTRIES = 1000;
+
+    jrmwng::deferred_printf<4000, true, jrmwng::overflow_block> logger;
+    static_assert(noexcept(logger("Entry %d", 0)), "Blocking never throws");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nTHREADS; ++t)
+    {
+        threads.emplace_back([&logger, t]() {
+            for (int i = 0; i < nENTRIES; ++i)
+            {
+                logger("%d %d", t, i);
+            }
+        });
+    }
+
+    std::vector<int> next(nTHREADS, 0);
+    int nEntries = 0;
+    auto consume = [&](char const *pcFormat, va_list args) -> int {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+        int t = -1, i = -1;
+        sscanf(buffer, "%d %d", &t, &i);
+        assert(t >= 0 && t < nTHREADS);
+        assert(next[t] == i); // nothing is lost or reordered
+        ++next[t];
+        ++nEntries;
+        return 0;
+    };
+    while (nEntries < nTHREADS * nENTRIES)
+    {
+        logger.drain(consume);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    logger.drain(consume);
+
+    assert(nEntries == nTHREADS * nENTRIES);
+    assert(logger.dropped() == 0);
+}
+
+void test_page_pool()
+{
+    jrmwng::deferred_printf_page_pool pool(128);
+    assert(pool.preallocate(4));
+    assert(pool.free_pages() == 4);
+    {
+        jrmwng::deferred_printf<128, false, jrmwng::overflow_grow> logger{ jrmwng::overflow_grow(pool) };
+
+        for (int i = 0; i < 100; ++i)
+        {
+            logger("Entry %d", i);
+        }
+        assert(pool.free_pages() == 0); // the logger took the preallocated pages and more
+
+        int nEntries = 0;
+        logger.drain([&nEntries](char const *pcFormat, va_list args) -> int {
+            char buffer[256];
+            vsnprintf(buffer, sizeof(buffer), pcFormat, args);
+            assert(buffer == "Entry " + std::to_string(nEntries));
+            ++nEntries;
+            return 0;
+        });
+        assert(nEntries == 100);
+
+        size_t const zuFree = pool.free_pages();
+        assert(zuFree > 4); // every page went back to the pool
+
+        logger("Entry %d", 100);
+        assert(pool.free_pages() == zuFree - 1); // and is reused
+    }
+}
+
 int main()
 {
     test_basic_logging();
@@ -226,6 +1686,37 @@ int main()
     test_large_logger();
     test_fprintf();
     test_dynamic_buffer_allocation();
+    test_concurrent_logging();
+    test_concurrent_overflow();
+    test_drain_while_logging();
+    test_compact_header();
+    test_packed_tokens();
+    test_template_callback();
+    test_native_format();
+    test_compile_time_format();
+    test_format_interning();
+    test_binary_export();
+    test_copy_string();
+    test_timestamps();
+    test_merge();
+    test_registry();
+    test_severity();
+    test_filtered_apply();
+    test_runtime_format_id();
+    test_apply_checked();
+    test_fd_sink();
+    test_stats();
+    test_clear();
+    test_move_and_detach();
+    test_allocator();
+    test_drainer();
+    test_ring_buffer();
+    test_ring_buffer_without_wrap();
+    test_overflow_drop();
+    test_overflow_flush();
+    test_overflow_grow();
+    test_overflow_block();
+    test_page_pool();
 
     std::cout << "All tests passed!" << std::endl;
     return 0;
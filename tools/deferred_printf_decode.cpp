@@ -0,0 +1,46 @@
+#include "deferred_printf_binary.h"
+
+#include <cstdio>
+#include <exception>
+
+/**
+ * @brief Decodes a binary log written by deferred_printf_binary_writer and prints its log entries.
+ *
+ * Usage: deferred_printf_decode [file]
+ * Reads from the standard input if no file is given.
+ */
+int main(int argc, char *argv[])
+{
+    std::FILE *pFile = stdin;
+    if (argc > 1)
+    {
+        pFile = std::fopen(argv[1], "rb");
+        if (pFile == nullptr)
+        {
+            std::perror(argv[1]);
+            return 1;
+        }
+    }
+
+    int nResult = 0;
+    try
+    {
+        jrmwng::deferred_printf_binary_reader reader([pFile](void *pv, size_t zuSize) { return std::fread(pv, 1, zuSize, pFile); });
+        std::string strText;
+        while (reader.read(strText))
+        {
+            std::fwrite(strText.data(), 1, strText.size(), stdout);
+        }
+    }
+    catch (std::exception const &e)
+    {
+        std::fprintf(stderr, "deferred_printf_decode: %s\n", e.what());
+        nResult = 1;
+    }
+
+    if (pFile != stdin)
+    {
+        std::fclose(pFile);
+    }
+    return nResult;
+}